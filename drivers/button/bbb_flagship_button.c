@@ -69,34 +69,47 @@ static ssize_t work_executions_show(struct device *dev,
     return sysfs_emit(buf, "%lld\n", atomic64_read(&b->work_executions));
 }
 
+/*
+ * Sysfs show function for event_overflows (events lagging readers missed)
+ */
+static ssize_t event_overflows_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct bbb_btn *b = dev_get_drvdata(dev);
+    return sysfs_emit(buf, "%lld\n", atomic64_read(&b->chardev.ring->overflows));
+}
+
 /* Define sysfs attributes */
 static DEVICE_ATTR_RO(press_count);
 static DEVICE_ATTR_RO(last_event_ns);
 static DEVICE_ATTR_RO(total_irqs);
 static DEVICE_ATTR_RO(work_executions);
+static DEVICE_ATTR_RO(event_overflows);
 
 static struct attribute *bbb_btn_attrs[] = {
     &dev_attr_press_count.attr,
     &dev_attr_last_event_ns.attr,
     &dev_attr_total_irqs.attr,
     &dev_attr_work_executions.attr,
+    &dev_attr_event_overflows.attr,
     NULL,
 };
 ATTRIBUTE_GROUPS(bbb_btn);
 
 /*
- * TODO: Implement IRQ handler
- *
- * This is called when the button triggers an interrupt.
- *
- * Hints:
- * - Get current time with ktime_get()
- * - Implement debounce: if time since last IRQ < debounce_ms, ignore
- * - Increment press counter
- * - Store timestamp
- * - Use dev_dbg() for debug logging
- * - Return IRQ_HANDLED
+ * Hard IRQ handler: timestamp the edge as close to the hardware as
+ * possible. Only the first edge of a bounce burst is kept; the debounce
+ * work consumes it, so the next burst starts fresh.
  */
+static irqreturn_t bbb_btn_hardirq(int irq, void *data)
+{
+    struct bbb_btn *b = data;
+
+    atomic64_cmpxchg(&b->pending_edge_ns, 0, ktime_get_ns());
+
+    return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t bbb_btn_irq(int irq, void *data)
 {
     struct bbb_btn *b = data;
@@ -138,12 +151,18 @@ static irqreturn_t bbb_btn_irq(int irq, void *data)
                                      debounce_work.work);
     int state;
     unsigned long flags;
-    char msg[256];
-
+    struct bbb_btn_event_rec ev;
+    bool changed = false;
+    u64 edge_ns;
 
     /* Read stable GPIO state after debounce delay */
     state = gpiod_get_value_cansleep(b->gpiod);
 
+    /* Edge time from the hard IRQ; consumed even if the state bounced back */
+    edge_ns = atomic64_xchg(&b->pending_edge_ns, 0);
+    if (!edge_ns)
+        edge_ns = ktime_get_ns();
+
     /* Debug: Count work executions */
     atomic64_inc(&b->work_executions);
 
@@ -157,10 +176,14 @@ static irqreturn_t bbb_btn_irq(int irq, void *data)
     /* Only process if state actually changed */
     if (state != b->last_state) {
         b->last_state = state;
-        atomic64_inc(&b->press_count);
-        atomic64_set(&b->last_event_ns, ktime_get_ns());
+        ev.press_count = atomic64_inc_return(&b->press_count);
+        ev.ts_ns = edge_ns;
+        ev.state = !state;      // Record is 1 = pressed (GPIO active low)
+        atomic64_set(&b->last_event_ns, ev.ts_ns);
         atomic64_inc(&b->work_executions);
+        changed = true;
 
+        input_set_timestamp(b->input, ns_to_ktime(edge_ns));
         input_report_key(b->input, KEY_ENTER, !state);  // !state because GPIO_ACTIVE_LOW
         input_sync(b->input);
 
@@ -174,12 +197,9 @@ static irqreturn_t bbb_btn_irq(int irq, void *data)
     b->work_pending = false;
     spin_unlock_irqrestore(&b->lock, flags);
 
-    snprintf(msg, sizeof(msg), "button %s: count=%lld time=%lld\n",
-                state ? "released" : "pressed",
-                atomic64_read(&b->press_count),
-                ktime_get_ns());            
-
-    bbb_chardev_push_event(b, msg);
+    /* Publish the transition; formatting happens in the reader */
+    if (changed)
+        bbb_chardev_push_event(b, &ev);
 
  }
 
@@ -232,19 +252,11 @@ static int bbb_btn_probe(struct platform_device *pdev)
     /* Initialize counters */
     atomic64_set(&b->press_count, 0);
     atomic64_set(&b->last_event_ns, 0);
+    atomic64_set(&b->pending_edge_ns, 0);
     atomic64_set(&b->total_irqs, 0);
     atomic64_set(&b->work_executions, 0);
     b->last_irq_time = ktime_set(0, 0);
 
-    /* Request IRQ on both edges to capture press/release if desired */
-    ret = devm_request_threaded_irq(&pdev->dev, b->irq,
-                                    NULL,              /* top-half */
-                                    bbb_btn_irq,       /* threaded handler */
-                                    IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING | IRQF_ONESHOT,
-                                    DRV_NAME, b);
-    if (ret)
-        return dev_err_probe(&pdev->dev, ret, "request_irq failed\n");
-
     /* sysfs files are automatically created by dev_groups in driver struct */
     spin_lock_init(&b->lock);
     INIT_DELAYED_WORK(&b->debounce_work, bbb_btn_debounce_work);
@@ -283,6 +295,20 @@ static int bbb_btn_probe(struct platform_device *pdev)
         return dev_err_probe(&pdev->dev, ret, "input registration failed\n");
     }
 
+    /*
+     * Request IRQ on both edges last: the handlers use the lock, work,
+     * chardev and input device set up above.
+     */
+    ret = devm_request_threaded_irq(&pdev->dev, b->irq,
+                                    bbb_btn_hardirq,   /* top-half: edge timestamp */
+                                    bbb_btn_irq,       /* threaded handler */
+                                    IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING | IRQF_ONESHOT,
+                                    DRV_NAME, b);
+    if (ret) {
+        bbb_chardev_unregister(b);
+        return dev_err_probe(&pdev->dev, ret, "request_irq failed\n");
+    }
+
     dev_info(&pdev->dev, "driver loaded (irq=%d, debounce=%u ms, input=%s)\n",
             b->irq, b->debounce_ms, b->input->name);         
 
@@ -297,6 +323,9 @@ static int bbb_btn_probe(struct platform_device *pdev)
 static void bbb_btn_remove(struct platform_device *pdev)
 {
     struct bbb_btn *b = platform_get_drvdata(pdev);
+
+    /* The devm IRQ outlives remove(); stop it before tearing down */
+    disable_irq(b->irq);
     cancel_delayed_work_sync(&b->debounce_work);
     bbb_chardev_unregister(b);
     dev_info(&pdev->dev, "bbb flagship button driver removed\n");
@@ -317,6 +346,8 @@ static struct platform_driver bbb_btn_driver = {
         .name = DRV_NAME,
         .of_match_table = bbb_btn_of_match,
         .dev_groups = bbb_btn_groups,
+        /* Probe may run concurrently with other devices' probes */
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
 };
 
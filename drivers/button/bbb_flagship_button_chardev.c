@@ -17,22 +17,132 @@
 #include <linux/cdev.h>    
 #include <linux/fs.h>      
 #include <linux/wait.h>    
+#include <linux/poll.h>
+#include <linux/log2.h>
+#include <linux/property.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include "bbb_flagship_button_chardev.h"
 
 #define DRV_NAME "bbb_flagship_button_chardev"
 
+static unsigned int event_queue_size = BBB_BTN_EVENT_QUEUE_DEFAULT;
+module_param(event_queue_size, uint, 0444);
+MODULE_PARM_DESC(event_queue_size,
+                 "Buffered events per reader, rounded up to a power of two (default 64, DT event-queue-size wins)");
 
 
 
 
+
+static void bbb_btn_ring_free(struct kref *ref)
+{
+    struct bbb_btn_ring *ring = container_of(ref, struct bbb_btn_ring, ref);
+
+    vfree(ring->hdr);
+    kfree(ring);
+}
+
+static void bbb_btn_ring_put(struct bbb_btn_ring *ring)
+{
+    kref_put(&ring->ref, bbb_btn_ring_free);
+}
+
+/* Per open file state */
+struct bbb_btn_file {
+    struct bbb_btn_ring *ring;  /* Own reference, outlives the device */
+    struct mutex lock;  /* Serializes readers sharing this file */
+    u32 tail;           /* Next ring index this file will read */
+    bool lagged;        /* Events were overwritten: flag the next one */
+    u32 format;         /* BBB_BTN_FORMAT_* */
+};
+
+/*
+ * Copy the next event for this file out of the ring without consuming
+ * it. Returns false when the file has caught up with the producer.
+ * Caller holds bf->lock and calls bbb_btn_ring_advance() once the event
+ * has been delivered.
+ *
+ * The producer bumps claim before it touches a slot, so a slot copy is
+ * good only if claim still shows the slot's index has not been reused.
+ * A reader that fell more than a ring behind skips to the oldest slot
+ * still intact and counts what it missed.
+ */
+static bool bbb_btn_ring_peek(struct bbb_btn_ring *ring, struct bbb_btn_file *bf,
+                              struct bbb_btn_event_rec *ev)
+{
+    u32 size = ring->size;
+    u32 head, claim;
+
+    for (;;) {
+        head = smp_load_acquire(&ring->hdr->head);
+        if (bf->tail == head)
+            return false;
+
+        claim = READ_ONCE(ring->hdr->claim);
+        if (claim - bf->tail > size) {
+            atomic64_add(claim - size - bf->tail, &ring->overflows);
+            WRITE_ONCE(bf->tail, claim - size);
+            bf->lagged = true;
+        }
+
+        *ev = ring->recs[bf->tail & (size - 1)];
+
+        smp_rmb();  // Pairs with smp_wmb() in bbb_chardev_push_event()
+        if (READ_ONCE(ring->hdr->claim) - bf->tail > size)
+            continue;   // Overwritten while copying
+
+        if (bf->lagged)
+            ev->flags |= BBB_BTN_EV_OVERFLOW;
+        return true;
+    }
+}
+
+static void bbb_btn_ring_advance(struct bbb_btn_file *bf)
+{
+    WRITE_ONCE(bf->tail, bf->tail + 1);
+    bf->lagged = false;
+}
+
+static bool bbb_btn_ring_empty(struct bbb_btn_ring *ring, struct bbb_btn_file *bf)
+{
+    return READ_ONCE(bf->tail) == smp_load_acquire(&ring->hdr->head);
+}
+
+/* Wake-up condition for readers: an event to read, or nothing ever will be */
+static bool bbb_btn_ring_ready(struct bbb_btn_ring *ring, struct bbb_btn_file *bf)
+{
+    return !bbb_btn_ring_empty(ring, bf) || READ_ONCE(ring->gone);
+}
+
 static int bbb_btn_chardev_open(struct inode *inode, struct file *file)
 {
     struct bbb_btn *btn;
+    struct bbb_btn_file *bf;
 
     btn = container_of(inode->i_cdev, struct bbb_btn, chardev.cdev);
 
+    bf = kzalloc(sizeof(*bf), GFP_KERNEL);
+    if (!bf)
+        return -ENOMEM;
+
+    bf->ring = btn->chardev.ring;
+    kref_get(&bf->ring->ref);
+    mutex_init(&bf->lock);
+    // New readers see events from now on
+    bf->tail = smp_load_acquire(&bf->ring->hdr->head);
+    // Reads consume events, the file position means nothing
+    stream_open(inode, file);
+
+    // The -bin minor starts in binary mode, the original node stays text
+    if (iminor(inode) - MINOR(btn->chardev.devt) == BBB_BTN_MINOR_BIN)
+        bf->format = BBB_BTN_FORMAT_BINARY;
+    else
+        bf->format = BBB_BTN_FORMAT_TEXT;
+
     // store in file->private_data
-    file->private_data = btn;
+    file->private_data = bf;
 
     dev_info(btn->chardev.char_dev, "bbb flagship button character device opened\n");
 
@@ -74,54 +184,212 @@ static int bbb_btn_chardev_open(struct inode *inode, struct file *file)
 // }
 
 
+/* Longest text line: both counters at their 20-digit maximum */
+#define BBB_BTN_TEXT_MAX    72
+
+/*
+ * Hand out as many whole events as fit in the user buffer, in the file's
+ * format. A record or line is never split: a buffer too small for the
+ * next one gets -EINVAL, while a zero-length read returns 0 at once.
+ * Blocks until at least one event is available unless the file is
+ * O_NONBLOCK. Once the device is gone, events already in the ring can
+ * still be drained, then reads fail with -ENODEV.
+ */
 static ssize_t bbb_btn_chardev_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
 {
-    struct bbb_btn *btn = file->private_data;
-    char local_buf[256];
+    struct bbb_btn_file *bf = file->private_data;
+    struct bbb_btn_ring *ring = bf->ring;
+    struct bbb_btn_event_rec ev;
+    char line[BBB_BTN_TEXT_MAX];
+    const void *src;
+    size_t done = 0, len;
+    bool fit = true;
+    int ret = 0;
+
+    if (!count)
+        return 0;
+
+    for (;;) {
+        if (bbb_btn_ring_empty(ring, bf)) {
+            if (READ_ONCE(ring->gone))
+                return -ENODEV;
+            if (file->f_flags & O_NONBLOCK)
+                return -EAGAIN;
+
+            /* Block until an event is published past this file's cursor */
+            ret = wait_event_interruptible(ring->wait,
+                                           bbb_btn_ring_ready(ring, bf));
+            if (ret)
+                return -ERESTARTSYS;
+        }
+
+        // Threads sharing this file exclude each other; other files and
+        // the producer are unaffected
+        mutex_lock(&bf->lock);
+        while (bbb_btn_ring_peek(ring, bf, &ev)) {
+            if (bf->format == BBB_BTN_FORMAT_BINARY) {
+                src = &ev;
+                len = sizeof(ev);
+            } else {
+                /* Format at read time, from the copied record */
+                src = line;
+                len = scnprintf(line, sizeof(line),
+                                "button %s: count=%llu time=%llu\n",
+                                ev.state ? "pressed" : "released",
+                                ev.press_count, ev.ts_ns);
+            }
+
+            if (len > count - done) {
+                fit = false;
+                break;
+            }
+            if (copy_to_user(buf + done, src, len)) {
+                ret = -EFAULT;
+                break;
+            }
+
+            bbb_btn_ring_advance(bf);
+            done += len;
+        }
+        mutex_unlock(&bf->lock);
+
+        if (done)
+            return done;
+        if (ret)
+            return ret;
+        if (!fit)
+            return -EINVAL;
+        // Another thread on this file drained it first, or the device
+        // went away: check again
+    }
+}
+
+/*
+ * Readable while events are published past this file's cursor. Other
+ * open files do not consume them. Hung up once the device is gone.
+ */
+static __poll_t bbb_btn_chardev_poll(struct file *file, poll_table *wait)
+{
+    struct bbb_btn_file *bf = file->private_data;
+    struct bbb_btn_ring *ring = bf->ring;
+    __poll_t mask = 0;
+
+    poll_wait(file, &ring->wait, wait);
+
+    if (!bbb_btn_ring_empty(ring, bf))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (READ_ONCE(ring->gone))
+        mask |= EPOLLHUP | EPOLLERR;
+
+    return mask;
+}
+
+/* Every mapping pins the ring pages until it is unmapped */
+static void bbb_btn_vma_open(struct vm_area_struct *vma)
+{
+    struct bbb_btn_ring *ring = vma->vm_private_data;
+
+    kref_get(&ring->ref);
+}
+
+static void bbb_btn_vma_close(struct vm_area_struct *vma)
+{
+    bbb_btn_ring_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct bbb_btn_vm_ops = {
+    .open = bbb_btn_vma_open,
+    .close = bbb_btn_vma_close,
+};
+
+/*
+ * Map the event ring read-only for consumers that want to avoid a syscall
+ * per event. They follow the protocol in bbb_flagship_button_uapi.h and
+ * use poll() on the same fd to sleep.
+ */
+static int bbb_btn_chardev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct bbb_btn_file *bf = file->private_data;
+    struct bbb_btn_ring *ring = bf->ring;
     int ret;
-    unsigned long flags;
-    size_t len;
 
-    /* Block until event is available */
-    ret = wait_event_interruptible(btn->chardev.wait, btn->chardev.has_event);
-    if (ret)
-        return -ERESTARTSYS;
+    if (READ_ONCE(ring->gone))
+        return -ENODEV;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start > ring->bytes)
+        return -EINVAL;
 
-    // Copy event to LOCAL buffer first (while locked)
-    spin_lock_irqsave(&btn->chardev.lock, flags);
-    if (!btn->chardev.has_event) {
-        spin_unlock_irqrestore(&btn->chardev.lock, flags);
-        return -EAGAIN;
-    }
+    vma->vm_flags &= ~VM_MAYWRITE;
+    ret = remap_vmalloc_range(vma, ring->hdr, 0);
+    if (ret)
+        return ret;
 
-    len = strlen(btn->chardev.buffer);
-    if (len >= sizeof(local_buf))  // Safety check
-        len = sizeof(local_buf) - 1;
-    
-    memcpy(local_buf, btn->chardev.buffer, len);  // Copy to local
-    local_buf[len] = '\0';
-    
-    btn->chardev.has_event = false;
-    spin_unlock_irqrestore(&btn->chardev.lock, flags);  // Release BEFORE copy_to_user!
+    // ->open is not called for the initial mapping, take its reference here
+    vma->vm_ops = &bbb_btn_vm_ops;
+    vma->vm_private_data = ring;
+    bbb_btn_vma_open(vma);
+    return 0;
+}
 
-    
-    if (count < len)
-        len = count;
+/*
+ * Move this file's read cursor to an mmap consumer's tail, so poll()
+ * waits for events after it. The index must still be in the ring.
+ */
+static long bbb_btn_set_tail(struct bbb_btn_file *bf, u32 __user *argp)
+{
+    struct bbb_btn_ring *ring = bf->ring;
+    u32 tail, head;
 
-    
-    // Now copy to userspace (NOT in atomic context)
-    if (copy_to_user(buf, local_buf, len)) {
+    if (get_user(tail, argp))
         return -EFAULT;
+
+    mutex_lock(&bf->lock);
+    head = smp_load_acquire(&ring->hdr->head);
+    if (head - tail > ring->size) {
+        mutex_unlock(&bf->lock);
+        return -EINVAL;
     }
+    WRITE_ONCE(bf->tail, tail);
+    mutex_unlock(&bf->lock);
 
-    return len;
+    return 0;
+}
+
+static long bbb_btn_chardev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct bbb_btn_file *bf = file->private_data;
+    u32 __user *argp = (u32 __user *)arg;
+    u32 format;
+
+    if (READ_ONCE(bf->ring->gone))
+        return -ENODEV;
+
+    switch (cmd) {
+    case BBB_BTN_IOC_SET_FORMAT:
+        if (get_user(format, argp))
+            return -EFAULT;
+        if (format != BBB_BTN_FORMAT_TEXT && format != BBB_BTN_FORMAT_BINARY)
+            return -EINVAL;
+        WRITE_ONCE(bf->format, format);
+        return 0;
+    case BBB_BTN_IOC_GET_FORMAT:
+        return put_user(READ_ONCE(bf->format), argp);
+    case BBB_BTN_IOC_SET_TAIL:
+        return bbb_btn_set_tail(bf, argp);
+    default:
+        return -ENOTTY;
+    }
 }
 
 static int bbb_btn_chardev_release(struct inode *inode, struct file *file)
 {
-    struct bbb_btn *btn = file->private_data;
+    struct bbb_btn_file *bf = file->private_data;
 
-    dev_info(btn->dev, "bbb flagship button character device closed\n");
+    // The device may already be unbound, don't touch it
+    pr_info(DRV_NAME ": bbb flagship button character device closed\n");
+    bbb_btn_ring_put(bf->ring);
+    kfree(bf);
     return 0;
 }
 
@@ -129,6 +397,10 @@ static const struct file_operations bbb_btn_chardev_fops = {
     .owner = THIS_MODULE,
     .open = bbb_btn_chardev_open,
     .read = bbb_btn_chardev_read,
+    .poll = bbb_btn_chardev_poll,
+    .mmap = bbb_btn_chardev_mmap,
+    .unlocked_ioctl = bbb_btn_chardev_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
     .release = bbb_btn_chardev_release,
 };
 
@@ -168,19 +440,49 @@ static const struct file_operations bbb_btn_chardev_fops = {
 
 int bbb_chardev_register(struct bbb_btn *btn, struct device *parent)
 {
+    struct bbb_btn_ring *ring;
+    u32 size = event_queue_size;
+    struct device *dev;
     int ret;
-    
-    // Allocate device number
-    ret = alloc_chrdev_region(&btn->chardev.devt, 0, 1, "bbb-button");
+
+    // Queue depth: DT property, else module parameter
+    device_property_read_u32(parent, "event-queue-size", &size);
+    size = roundup_pow_of_two(clamp_val(size, 2, 4096));
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (!ring)
+        return -ENOMEM;
+    kref_init(&ring->ref);      // The device's reference
+    ring->bytes = PAGE_SIZE + PAGE_ALIGN(size * sizeof(*ring->recs));
+    ring->hdr = vmalloc_user(ring->bytes);     // Zeroed
+    if (!ring->hdr) {
+        kfree(ring);
+        return -ENOMEM;
+    }
+    ring->recs = (void *)ring->hdr + PAGE_SIZE;
+    ring->size = size;
+    atomic64_set(&ring->overflows, 0);
+    init_waitqueue_head(&ring->wait);
+
+    ring->hdr->version = BBB_BTN_RING_VERSION;
+    ring->hdr->ring_size = size;
+    ring->hdr->record_size = sizeof(*ring->recs);
+    ring->hdr->data_offset = PAGE_SIZE;
+    ring->hdr->ring_bytes = ring->bytes;
+    btn->chardev.ring = ring;
+    btn->chardev.next_seq = 0;
+
+    // Allocate device numbers: text and binary minors
+    ret = alloc_chrdev_region(&btn->chardev.devt, 0, BBB_BTN_NR_MINORS, "bbb-button");
     if (ret)
-        return ret;
+        goto err_ring_free;
     
     // Initialize and add cdev
     cdev_init(&btn->chardev.cdev, &bbb_btn_chardev_fops);
 
     btn->chardev.cdev.owner = THIS_MODULE;
     
-    ret = cdev_add(&btn->chardev.cdev, btn->chardev.devt, 1);
+    ret = cdev_add(&btn->chardev.cdev, btn->chardev.devt, BBB_BTN_NR_MINORS);
     if (ret)
         goto err_unregister;
     
@@ -197,44 +499,77 @@ int bbb_chardev_register(struct bbb_btn *btn, struct device *parent)
         ret = PTR_ERR(btn->chardev.char_dev);
         goto err_class_destroy;
     }
+
+    dev = device_create(btn->chardev.class, parent,
+                        MKDEV(MAJOR(btn->chardev.devt), MINOR(btn->chardev.devt) + BBB_BTN_MINOR_BIN),
+                        NULL, "bbb-button-bin");
+    if (IS_ERR(dev)) {
+        ret = PTR_ERR(dev);
+        goto err_device_destroy;
+    }
     
-    // Initialize wait queue and spinlock
-    init_waitqueue_head(&btn->chardev.wait);
-    spin_lock_init(&btn->chardev.lock);
-    btn->chardev.has_event = false;
-    
-    dev_info(parent, "Character device /dev/bbb-button registered\n");
+    dev_info(parent, "Character devices /dev/bbb-button{,-bin} registered (ring=%u)\n",
+             ring->size);
     return 0;
 
+err_device_destroy:
+    device_destroy(btn->chardev.class, btn->chardev.devt);
 err_class_destroy:
     class_destroy(btn->chardev.class);
 err_cdev_del:
     cdev_del(&btn->chardev.cdev);
 err_unregister:
-    unregister_chrdev_region(btn->chardev.devt, 1);
+    unregister_chrdev_region(btn->chardev.devt, BBB_BTN_NR_MINORS);
+err_ring_free:
+    bbb_btn_ring_put(ring);
     return ret;
 }
 
+/*
+ * The producer has stopped by now. Files and mappings still open keep
+ * the ring alive; mark it gone so they see -ENODEV and hang-up instead
+ * of waiting for events that will never come, and drop the device's
+ * reference.
+ */
 void bbb_chardev_unregister(struct bbb_btn *btn)
 {
-    wake_up_interruptible(&btn->chardev.wait);
+    struct bbb_btn_ring *ring = btn->chardev.ring;
+
+    WRITE_ONCE(ring->gone, true);
+    wake_up_interruptible_poll(&ring->wait, EPOLLHUP | EPOLLERR);
+    device_destroy(btn->chardev.class,
+                   MKDEV(MAJOR(btn->chardev.devt), MINOR(btn->chardev.devt) + BBB_BTN_MINOR_BIN));
     device_destroy(btn->chardev.class, btn->chardev.devt);
     class_destroy(btn->chardev.class);
     cdev_del(&btn->chardev.cdev);
-    unregister_chrdev_region(btn->chardev.devt, 1);
+    unregister_chrdev_region(btn->chardev.devt, BBB_BTN_NR_MINORS);
+    bbb_btn_ring_put(ring);
 }
 
-void bbb_chardev_push_event(struct bbb_btn *btn, const char *msg)
+/*
+ * Publish one event to every reader. Only the debounce work calls this,
+ * so the ring has a single producer and needs no lock. The cost does not
+ * depend on the number of readers: the oldest slot is overwritten and
+ * readers that have not consumed it yet notice on their next read.
+ */
+void bbb_chardev_push_event(struct bbb_btn *btn, const struct bbb_btn_event_rec *ev)
 {
-    unsigned long flags;
-    
-    spin_lock_irqsave(&btn->chardev.lock, flags);
-    strncpy(btn->chardev.buffer, msg, sizeof(btn->chardev.buffer) - 1);
-    btn->chardev.buffer[sizeof(btn->chardev.buffer) - 1] = '\0';  // ADD THIS LINE!
-    btn->chardev.has_event = true;
-    spin_unlock_irqrestore(&btn->chardev.lock, flags);
-    
-    wake_up_interruptible(&btn->chardev.wait);
+    struct bbb_btn_ring *ring = btn->chardev.ring;
+    u32 head = ring->hdr->head;
+    struct bbb_btn_event_rec *slot;
+
+    slot = &ring->recs[head & (ring->size - 1)];
+
+    WRITE_ONCE(ring->hdr->claim, head + 1);
+    smp_wmb();  // Claim before overwriting, pairs with bbb_btn_ring_peek()
+
+    *slot = *ev;
+    slot->seq = btn->chardev.next_seq++;
+    slot->flags = 0;
+
+    smp_store_release(&ring->hdr->head, head + 1);
+
+    wake_up_interruptible_poll(&ring->wait, EPOLLIN | EPOLLRDNORM);
 }
 
 // void bbb_chardev_push_event(struct bbb_btn *btn, const char *msg)
@@ -2,8 +2,41 @@
 #define BBB_FLAGSHIP_BUTTON_H
 
 #include <linux/cdev.h>
+#include <linux/kref.h>
 #include <linux/wait.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include "bbb_flagship_button_uapi.h"
+
+/* Default event ring depth, overridden by DT "event-queue-size" */
+#define BBB_BTN_EVENT_QUEUE_DEFAULT 64
+
+/* Minors: text by default, binary records by default */
+#define BBB_BTN_MINOR_TEXT  0
+#define BBB_BTN_MINOR_BIN   1
+#define BBB_BTN_NR_MINORS   2
+
+/*
+ * Broadcast event ring: single producer (debounce work), no lock.
+ * Every open file has its own read cursor into it; the producer
+ * overwrites the oldest slot and never waits for readers.
+ * Lives in vmalloc_user() memory so it can be mmap()ed: a header
+ * page holding head/claim, then the records.
+ *
+ * Refcounted apart from the devm-allocated struct bbb_btn: the device
+ * holds one reference until unregister, every open file and every
+ * mapping of it holds another, so readers can outlive an unbind.
+ */
+struct bbb_btn_ring {
+    struct kref ref;
+    bool gone;              // Device unregistered, no more events
+    struct bbb_btn_ring_header *hdr;
+    struct bbb_btn_event_rec *recs;
+    u32 size;               // Power of two, kernel copy of hdr->ring_size
+    size_t bytes;
+    atomic64_t overflows;   // Events overwritten before a reader got them
+    wait_queue_head_t wait;
+};
 
 /* Main driver state - shared by platform and chardev */
 struct bbb_btn {
@@ -13,6 +46,7 @@ struct bbb_btn {
     int irq;
     atomic64_t press_count;
     atomic64_t last_event_ns;
+    atomic64_t pending_edge_ns; // First edge of the current bounce burst, 0 = none
     atomic64_t total_irqs;
     atomic64_t work_executions;
     u32 debounce_ms;
@@ -28,11 +62,8 @@ struct bbb_btn {
         struct class *class;
         struct device *char_dev;
         
-        // Event buffer
-        char buffer[256];
-        bool has_event;
-        wait_queue_head_t wait;
-        spinlock_t lock;
+        struct bbb_btn_ring *ring;
+        u64 next_seq;           // Producer only
     } chardev;
 
     struct input_dev *input; 
@@ -41,6 +72,6 @@ struct bbb_btn {
 /* Character device functions (implemented in _chardev.c) */
 int bbb_chardev_register(struct bbb_btn *btn, struct device *parent);
 void bbb_chardev_unregister(struct bbb_btn *btn);
-void bbb_chardev_push_event(struct bbb_btn *btn, const char *msg);
+void bbb_chardev_push_event(struct bbb_btn *btn, const struct bbb_btn_event_rec *ev);
 
 #endif /* BBB_FLAGSHIP_BUTTON_H */
\ No newline at end of file
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * BBB Flagship Button - userspace ABI for /dev/bbb-button
+ *
+ * /dev/bbb-button      - text lines by default
+ * /dev/bbb-button-bin  - struct bbb_btn_event_rec records by default
+ *
+ * Either node can be switched per open file with BBB_BTN_IOC_SET_FORMAT.
+ * In binary format every read returns whole records.
+ *
+ * Both nodes can also be mapped read-only (offset 0, up to ring_bytes as
+ * reported in the header page) to consume events without syscalls:
+ *
+ *   page 0                  struct bbb_btn_ring_header
+ *   data_offset onwards     ring_size x struct bbb_btn_event_rec
+ *
+ * The ring is shared by all consumers and never waits for them, so each
+ * consumer keeps its own tail index in its own memory. Start from head,
+ * then for each event:
+ *
+ *   head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+ *   if (tail == head)
+ *       -> caught up: spin, or BBB_BTN_IOC_SET_TAIL(tail) then poll()
+ *   claim = __atomic_load_n(&hdr->claim, __ATOMIC_RELAXED);
+ *   if (claim - tail > ring_size)
+ *       tail = claim - ring_size;      -> missed events
+ *   rec = ring[tail & (ring_size - 1)];
+ *   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *   if (__atomic_load_n(&hdr->claim, __ATOMIC_RELAXED) - tail > ring_size)
+ *       -> overwritten while copying, retry
+ *   tail++;
+ *
+ * All indices are __u32 and wrap; compare them by unsigned difference.
+ * poll() reports the fd readable while its read() cursor is behind head;
+ * BBB_BTN_IOC_SET_TAIL moves that cursor to the consumer's tail so poll()
+ * sleeps until the next event.
+ *
+ * Author: Chun
+ */
+
+#ifndef _UAPI_BBB_FLAGSHIP_BUTTON_H
+#define _UAPI_BBB_FLAGSHIP_BUTTON_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* One debounced button transition (32 bytes, native endian) */
+struct bbb_btn_event_rec {
+    __u64 seq;          /* Event number, consecutive unless flags has OVERFLOW */
+    __u64 ts_ns;        /* CLOCK_MONOTONIC ns of the first edge, taken in hard IRQ */
+    __u64 press_count;  /* Transitions so far, including this one */
+    __u32 state;        /* 1 = pressed, 0 = released */
+    __u32 flags;        /* BBB_BTN_EV_* */
+};
+
+/* This reader fell a ring behind and missed events right before this one */
+#define BBB_BTN_EV_OVERFLOW     (1U << 0)
+
+/* First page of the mapping, written only by the driver */
+struct bbb_btn_ring_header {
+    __u32 version;      /* BBB_BTN_RING_VERSION */
+    __u32 ring_size;    /* Records in the ring, a power of two */
+    __u32 record_size;  /* sizeof(struct bbb_btn_event_rec) */
+    __u32 data_offset;  /* Bytes from the mapping start to record 0 */
+    __u32 ring_bytes;   /* Total mapping size */
+    __u32 head;         /* Next index to be published */
+    __u32 claim;        /* head + 1 while that slot is being rewritten */
+    __u32 reserved;
+};
+
+#define BBB_BTN_RING_VERSION    1
+
+/* Read formats */
+#define BBB_BTN_FORMAT_TEXT     0
+#define BBB_BTN_FORMAT_BINARY   1
+
+#define BBB_BTN_IOC_MAGIC       'B'
+#define BBB_BTN_IOC_SET_FORMAT  _IOW(BBB_BTN_IOC_MAGIC, 1, __u32)
+#define BBB_BTN_IOC_GET_FORMAT  _IOR(BBB_BTN_IOC_MAGIC, 2, __u32)
+#define BBB_BTN_IOC_SET_TAIL    _IOW(BBB_BTN_IOC_MAGIC, 3, __u32)
+
+#endif /* _UAPI_BBB_FLAGSHIP_BUTTON_H */
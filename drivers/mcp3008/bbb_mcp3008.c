@@ -9,15 +9,52 @@
 #include <linux/module.h>
 #include <linux/spi/spi.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/consumer.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
 #include <linux/regulator/consumer.h>
-
-#define MCP3008_CHANNELS 8
-
-/* Driver private data */
-struct mcp3008 {
-	struct spi_device *spi;
-	struct regulator *vref;
-	u16 vref_mv;  /* Reference voltage in millivolts */
+#include <linux/property.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/devm-helpers.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+
+#include "bbb_mcp3008.h"
+
+/* Temperature compensation defaults */
+#define MCP3008_TEMP_REF_MC	25000	/* Reference temperature (m°C) */
+#define MCP3008_TEMP_POLL_MS	1000	/* Temperature cache refresh period */
+
+VISIBLE_IF_MCP3008_KUNIT unsigned int mcp3008_spi_retries;
+EXPORT_SYMBOL_IF_MCP3008_KUNIT(mcp3008_spi_retries);
+module_param_named(spi_retries, mcp3008_spi_retries, uint, 0644);
+MODULE_PARM_DESC(spi_retries, "Retries for a failed SPI transfer (default 0)");
+
+static ssize_t mcp3008_temp_coeff_read(struct iio_dev *indio_dev,
+				       uintptr_t private,
+				       struct iio_chan_spec const *chan,
+				       char *buf);
+static ssize_t mcp3008_temp_coeff_write(struct iio_dev *indio_dev,
+					uintptr_t private,
+					struct iio_chan_spec const *chan,
+					const char *buf, size_t len);
+
+/* Per-channel extended attributes: in_voltageN_temp_coeff */
+static const struct iio_chan_spec_ext_info mcp3008_ext_info[] = {
+	{
+		.name = "temp_coeff",
+		.shared = IIO_SEPARATE,
+		.read = mcp3008_temp_coeff_read,
+		.write = mcp3008_temp_coeff_write,
+	},
+	{ }
 };
 
 /* Helper macro to define IIO channels */
@@ -28,10 +65,18 @@ struct mcp3008 {
 	.address = (chan),					\
 	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),		\
 	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),	\
+	.ext_info = mcp3008_ext_info,				\
+	.scan_index = (chan),					\
+	.scan_type = {						\
+		.sign = 'u',					\
+		.realbits = 10,					\
+		.storagebits = 16,				\
+		.endianness = IIO_CPU,				\
+	},							\
 }
 
 /* Define 8 channels */
-static const struct iio_chan_spec mcp3008_channels[] = {
+VISIBLE_IF_MCP3008_KUNIT const struct iio_chan_spec mcp3008_channels[] = {
 	MCP3008_CHANNEL(0),
 	MCP3008_CHANNEL(1),
 	MCP3008_CHANNEL(2),
@@ -40,7 +85,17 @@ static const struct iio_chan_spec mcp3008_channels[] = {
 	MCP3008_CHANNEL(5),
 	MCP3008_CHANNEL(6),
 	MCP3008_CHANNEL(7),
+	IIO_CHAN_SOFT_TIMESTAMP(MCP3008_CHANNELS),
 };
+EXPORT_SYMBOL_IF_MCP3008_KUNIT(mcp3008_channels);
+
+static void mcp3008_hist_add(atomic64_t *hist, u64 ns)
+{
+	unsigned int bucket = ns ? ilog2(ns) : 0;
+
+	atomic64_inc(&hist[min_t(unsigned int, bucket,
+				 MCP3008_HIST_BUCKETS - 1)]);
+}
 
 /**
  * mcp3008_adc_conversion - Read ADC value from specified channel
@@ -49,9 +104,14 @@ static const struct iio_chan_spec mcp3008_channels[] = {
  *
  * Returns: 10-bit ADC value (0-1023) on success, negative error code on failure
  */
-static int mcp3008_adc_conversion(struct mcp3008 *adc, u8 channel)
+VISIBLE_IF_MCP3008_KUNIT int mcp3008_adc_conversion(struct mcp3008 *adc,
+						    u8 channel)
 {
+	struct mcp3008_stats *stats = &adc->stats;
 	u8 tx[3], rx[3];
+	unsigned int attempt;
+	ktime_t start, bus_start;
+	u64 bus_ns;
 	int ret;
 	struct spi_transfer xfer = {
 		.tx_buf = tx,
@@ -59,35 +119,194 @@ static int mcp3008_adc_conversion(struct mcp3008 *adc, u8 channel)
 		.len = 3,
 	};
 
+	start = ktime_get();
+
 	/* Prepare command: single-ended mode */
 	tx[0] = 0x01;			/* Start bit */
 	tx[1] = 0x80 | (channel << 4);	/* Single-ended + channel select */
 	tx[2] = 0x00;			/* Don't care */
 
-	ret = spi_sync_transfer(adc->spi, &xfer, 1);
-	if (ret < 0)
+	for (attempt = 0; ; attempt++) {
+		bus_start = ktime_get();
+		ret = spi_sync_transfer(adc->spi, &xfer, 1);
+		bus_ns = ktime_to_ns(ktime_sub(ktime_get(), bus_start));
+
+		atomic64_add(bus_ns, &stats->bus_busy_ns);
+		mcp3008_hist_add(stats->bus_hist, bus_ns);
+
+		if (ret >= 0 || attempt >= READ_ONCE(mcp3008_spi_retries))
+			break;
+		atomic64_inc(&stats->retries);
+	}
+
+	if (ret < 0) {
+		atomic64_inc(&stats->errors);
 		return ret;
+	}
+
+	atomic64_inc(&stats->conversions);
+	mcp3008_hist_add(stats->conv_hist,
+			 ktime_to_ns(ktime_sub(ktime_get(), start)));
 
 	/* Extract 10-bit result */
 	return ((rx[1] & 0x03) << 8) | rx[2];
 }
+EXPORT_SYMBOL_IF_MCP3008_KUNIT(mcp3008_adc_conversion);
+
+/**
+ * mcp3008_hist_record - Count a raw conversion result in the code histogram
+ */
+static void mcp3008_hist_record(struct mcp3008 *adc, u8 channel, int code)
+{
+	if (!READ_ONCE(adc->code_hist_enabled))
+		return;
+
+	spin_lock(&adc->hist_lock);
+	adc->code_hist[channel][code]++;
+	spin_unlock(&adc->hist_lock);
+}
+
+/**
+ * mcp3008_temp_compensate - Apply linear temperature drift correction
+ * @adc: MCP3008 device structure
+ * @channel: Channel number (0-7)
+ * @code: Raw 10-bit conversion result
+ *
+ * Subtracts temp_coeff[channel] * (T - T_ref) from the sample, using the
+ * latest cached temperature. Channels with a zero coefficient, or devices
+ * without a temperature source, are returned unchanged.
+ *
+ * Returns: corrected code, clamped to 0..1023
+ */
+static int mcp3008_temp_compensate(struct mcp3008 *adc, u8 channel, int code)
+{
+	s32 coeff = READ_ONCE(adc->temp_coeff[channel]);
+	s64 drift;
+
+	if (!coeff || !READ_ONCE(adc->temp_valid))
+		return code;
+
+	/* uV/°C * m°C = nV; one LSB is vref_mv * 10^6 / 1024 nV */
+	drift = (s64)coeff * (READ_ONCE(adc->temp_mc) - adc->temp_ref_mc);
+	drift = div64_s64(drift * 1024, (s64)adc->vref_mv * 1000000);
+
+	return clamp_t(s64, code - drift, 0, MCP3008_MAX_CODE);
+}
+
+/**
+ * mcp3008_temp_work - Refresh the cached temperature
+ */
+static void mcp3008_temp_work(struct work_struct *work)
+{
+	struct mcp3008 *adc = container_of(work, struct mcp3008,
+					   temp_work.work);
+	int temp_mc, ret;
+
+	ret = iio_read_channel_processed(adc->temp_chan, &temp_mc);
+	if (ret < 0) {
+		dev_warn_ratelimited(&adc->spi->dev,
+				     "temperature read failed: %d\n", ret);
+	} else {
+		WRITE_ONCE(adc->temp_mc, temp_mc);
+		WRITE_ONCE(adc->temp_valid, true);
+	}
+
+	schedule_delayed_work(&adc->temp_work,
+			      msecs_to_jiffies(adc->temp_poll_ms));
+}
+
+static ssize_t mcp3008_temp_coeff_read(struct iio_dev *indio_dev,
+				       uintptr_t private,
+				       struct iio_chan_spec const *chan,
+				       char *buf)
+{
+	struct mcp3008 *adc = iio_priv(indio_dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(adc->temp_coeff[chan->address]));
+}
+
+static ssize_t mcp3008_temp_coeff_write(struct iio_dev *indio_dev,
+					uintptr_t private,
+					struct iio_chan_spec const *chan,
+					const char *buf, size_t len)
+{
+	struct mcp3008 *adc = iio_priv(indio_dev);
+	s32 coeff;
+	int ret;
+
+	ret = kstrtos32(buf, 0, &coeff);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(adc->temp_coeff[chan->address], coeff);
+	return len;
+}
+
+/**
+ * mcp3008_read_scan - Convert every channel in a scan mask into adc->scan
+ * @adc: MCP3008 device structure
+ * @mask: Channels to convert, packed in ascending order
+ * @masklength: Number of bits in @mask
+ *
+ * Returns: 0 on success, negative error code from the first failed conversion
+ */
+VISIBLE_IF_MCP3008_KUNIT int mcp3008_read_scan(struct mcp3008 *adc,
+					       const unsigned long *mask,
+					       unsigned int masklength)
+{
+	int bit, i = 0, ret;
+
+	for_each_set_bit(bit, mask, masklength) {
+		ret = mcp3008_adc_conversion(adc, bit);
+		if (ret < 0)
+			return ret;
+		mcp3008_hist_record(adc, bit, ret);
+		adc->scan.channels[i++] = mcp3008_temp_compensate(adc, bit, ret);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_IF_MCP3008_KUNIT(mcp3008_read_scan);
+
+/**
+ * mcp3008_trigger_handler - Read all enabled channels for one buffer scan
+ */
+static irqreturn_t mcp3008_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct mcp3008 *adc = iio_priv(indio_dev);
+
+	if (!mcp3008_read_scan(adc, indio_dev->active_scan_mask,
+			       indio_dev->masklength))
+		iio_push_to_buffers_with_timestamp(indio_dev, &adc->scan,
+						   pf->timestamp);
+
+	iio_trigger_notify_done(indio_dev->trig);
+	return IRQ_HANDLED;
+}
 
 /**
  * mcp3008_read_raw - IIO callback for reading channel data
  */
-static int mcp3008_read_raw(struct iio_dev *indio_dev,
-			   struct iio_chan_spec const *chan,
-			   int *val, int *val2, long mask)
+VISIBLE_IF_MCP3008_KUNIT int mcp3008_read_raw(struct iio_dev *indio_dev,
+					      struct iio_chan_spec const *chan,
+					      int *val, int *val2, long mask)
 {
 	struct mcp3008 *adc = iio_priv(indio_dev);
 	int ret;
 
 	switch (mask) {
 	case IIO_CHAN_INFO_RAW:
+		ret = iio_device_claim_direct_mode(indio_dev);
+		if (ret)
+			return ret;
 		ret = mcp3008_adc_conversion(adc, chan->address);
+		iio_device_release_direct_mode(indio_dev);
 		if (ret < 0)
 			return ret;
-		*val = ret;
+		mcp3008_hist_record(adc, chan->address, ret);
+		*val = mcp3008_temp_compensate(adc, chan->address, ret);
 		return IIO_VAL_INT;
 
 	case IIO_CHAN_INFO_SCALE:
@@ -99,13 +318,278 @@ static int mcp3008_read_raw(struct iio_dev *indio_dev,
 
 	return -EINVAL;
 }
+EXPORT_SYMBOL_IF_MCP3008_KUNIT(mcp3008_read_raw);
 
-static const struct iio_info mcp3008_info = {
+VISIBLE_IF_MCP3008_KUNIT const struct iio_info mcp3008_info = {
 	.read_raw = mcp3008_read_raw,
 };
+EXPORT_SYMBOL_IF_MCP3008_KUNIT(mcp3008_info);
+
+static int mcp3008_stats_show(struct seq_file *s, void *unused)
+{
+	struct mcp3008_stats *stats = s->private;
+	int i, last = 0;
+
+	seq_printf(s, "conversions: %lld\n", atomic64_read(&stats->conversions));
+	seq_printf(s, "errors:      %lld\n", atomic64_read(&stats->errors));
+	seq_printf(s, "retries:     %lld\n", atomic64_read(&stats->retries));
+	seq_printf(s, "bus_busy_ns: %lld\n", atomic64_read(&stats->bus_busy_ns));
+
+	for (i = 0; i < MCP3008_HIST_BUCKETS; i++)
+		if (atomic64_read(&stats->conv_hist[i]) ||
+		    atomic64_read(&stats->bus_hist[i]))
+			last = i;
+
+	seq_printf(s, "\n%-12s %14s %14s\n", "latency_ns", "conversion", "bus");
+	for (i = 0; i <= last; i++)
+		seq_printf(s, ">=%-10llu %14lld %14lld\n", 1ULL << i,
+			   atomic64_read(&stats->conv_hist[i]),
+			   atomic64_read(&stats->bus_hist[i]));
+
+	return 0;
+}
+
+static int mcp3008_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mcp3008_stats_show, inode->i_private);
+}
+
+/* Any write to the stats file clears all counters */
+static ssize_t mcp3008_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct mcp3008_stats *stats = file_inode(file)->i_private;
+	int i;
+
+	atomic64_set(&stats->conversions, 0);
+	atomic64_set(&stats->errors, 0);
+	atomic64_set(&stats->retries, 0);
+	atomic64_set(&stats->bus_busy_ns, 0);
+	for (i = 0; i < MCP3008_HIST_BUCKETS; i++) {
+		atomic64_set(&stats->conv_hist[i], 0);
+		atomic64_set(&stats->bus_hist[i], 0);
+	}
+
+	return count;
+}
+
+static const struct file_operations mcp3008_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mcp3008_stats_open,
+	.read = seq_read,
+	.write = mcp3008_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mcp3008_hist_enable_get(void *data, u64 *val)
+{
+	struct mcp3008 *adc = data;
+
+	*val = READ_ONCE(adc->code_hist_enabled);
+	return 0;
+}
+
+/* Enabling (re)starts accumulation from zero; disabling keeps the data */
+static int mcp3008_hist_enable_set(void *data, u64 val)
+{
+	struct mcp3008 *adc = data;
+	int ret = 0;
+
+	mutex_lock(&adc->hist_alloc_lock);
+
+	if (!val) {
+		WRITE_ONCE(adc->code_hist_enabled, false);
+		goto unlock;
+	}
+
+	if (!adc->code_hist) {
+		adc->code_hist = kvcalloc(MCP3008_CHANNELS,
+					  sizeof(*adc->code_hist), GFP_KERNEL);
+		if (!adc->code_hist) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+	}
+
+	spin_lock(&adc->hist_lock);
+	memset(adc->code_hist, 0, MCP3008_CHANNELS * sizeof(*adc->code_hist));
+	spin_unlock(&adc->hist_lock);
+
+	WRITE_ONCE(adc->code_hist_enabled, true);
+unlock:
+	mutex_unlock(&adc->hist_alloc_lock);
+	return ret;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(mcp3008_hist_enable_fops, mcp3008_hist_enable_get,
+			 mcp3008_hist_enable_set, "%llu\n");
+
+/*
+ * Opening a histogram file takes a snapshot of the channel's 1024 u32
+ * bins; the *_drain variant also clears them in the same critical section
+ * so no sample is lost or counted twice between successive reads.
+ */
+static int mcp3008_hist_open(struct inode *inode, struct file *file)
+{
+	struct mcp3008_hist_file *hf = inode->i_private;
+	struct mcp3008 *adc = hf->adc;
+	u32 *snap;
+
+	/* Pairs with the allocation under hist_alloc_lock */
+	mutex_lock(&adc->hist_alloc_lock);
+	if (!adc->code_hist) {
+		mutex_unlock(&adc->hist_alloc_lock);
+		return -ENODATA;
+	}
+
+	snap = kvmalloc(sizeof(*adc->code_hist), GFP_KERNEL);
+	if (!snap) {
+		mutex_unlock(&adc->hist_alloc_lock);
+		return -ENOMEM;
+	}
+
+	spin_lock(&adc->hist_lock);
+	memcpy(snap, adc->code_hist[hf->channel], sizeof(*adc->code_hist));
+	if (hf->drain)
+		memset(adc->code_hist[hf->channel], 0, sizeof(*adc->code_hist));
+	spin_unlock(&adc->hist_lock);
+	mutex_unlock(&adc->hist_alloc_lock);
+
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t mcp3008_hist_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	return simple_read_from_buffer(buf, count, ppos, file->private_data,
+				       MCP3008_CODES * sizeof(u32));
+}
+
+static int mcp3008_hist_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations mcp3008_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = mcp3008_hist_open,
+	.read = mcp3008_hist_read,
+	.llseek = default_llseek,
+	.release = mcp3008_hist_release,
+};
+
+static void mcp3008_debugfs_remove(void *data)
+{
+	struct mcp3008 *adc = data;
+
+	debugfs_remove_recursive(adc->debugfs_dir);
+	kvfree(adc->code_hist);
+}
+
+/**
+ * mcp3008_debugfs_init - Create the driver's debugfs directory
+ *
+ * Files live in /sys/kernel/debug/mcp3008-<spi device>/. The IIO core
+ * only creates a per-device directory for drivers with register access,
+ * so the driver owns this one. Called before the IIO device is
+ * registered so that, on unbind, the files and the code histogram go away
+ * only after sampling has stopped.
+ */
+static int mcp3008_debugfs_init(struct mcp3008 *adc)
+{
+	struct device *dev = &adc->spi->dev;
+	struct dentry *dir, *hist_dir;
+	char name[32];
+	int i;
+
+	snprintf(name, sizeof(name), "mcp3008-%s", dev_name(dev));
+	dir = debugfs_create_dir(name, NULL);
+	adc->debugfs_dir = dir;
+
+	debugfs_create_file("stats", 0600, dir, &adc->stats,
+			    &mcp3008_stats_fops);
+
+	/*
+	 * code_hist/enable             - 1 to clear and start, 0 to stop
+	 * code_hist/in_voltageN        - u32[1024] snapshot
+	 * code_hist/in_voltageN_drain  - u32[1024] snapshot, then clear
+	 */
+	hist_dir = debugfs_create_dir("code_hist", dir);
+	debugfs_create_file_unsafe("enable", 0600, hist_dir, adc,
+				   &mcp3008_hist_enable_fops);
+
+	for (i = 0; i < MCP3008_CHANNELS * 2; i++) {
+		struct mcp3008_hist_file *hf = &adc->hist_files[i];
+
+		hf->adc = adc;
+		hf->channel = i / 2;
+		hf->drain = i & 1;
+		snprintf(name, sizeof(name), "in_voltage%u%s", hf->channel,
+			 hf->drain ? "_drain" : "");
+		debugfs_create_file(name, 0400, hist_dir, hf,
+				    &mcp3008_hist_fops);
+	}
+
+	return devm_add_action_or_reset(dev, mcp3008_debugfs_remove, adc);
+}
+
+/**
+ * mcp3008_temp_comp_init - Look up the optional temperature source
+ *
+ * DT example:
+ *   io-channels = <&tmp117 0>;
+ *   io-channel-names = "temp";
+ *   bbb,temp-coeff-microvolt-per-celsius = <0 0 120 0 0 0 0 -45>;
+ *   bbb,temp-ref-millicelsius = <25000>;
+ *   bbb,temp-poll-ms = <1000>;
+ */
+static int mcp3008_temp_comp_init(struct mcp3008 *adc)
+{
+	struct device *dev = &adc->spi->dev;
+	int ret;
+
+	adc->temp_chan = devm_iio_channel_get(dev, "temp");
+	if (IS_ERR(adc->temp_chan)) {
+		ret = PTR_ERR(adc->temp_chan);
+		adc->temp_chan = NULL;
+		if (ret == -ENODEV)
+			return 0;	/* No temperature source: no compensation */
+		return dev_err_probe(dev, ret, "failed to get temp channel\n");
+	}
+
+	adc->temp_ref_mc = MCP3008_TEMP_REF_MC;
+	device_property_read_u32(dev, "bbb,temp-ref-millicelsius",
+				 (u32 *)&adc->temp_ref_mc);
+
+	adc->temp_poll_ms = MCP3008_TEMP_POLL_MS;
+	device_property_read_u32(dev, "bbb,temp-poll-ms", &adc->temp_poll_ms);
+	if (!adc->temp_poll_ms)
+		adc->temp_poll_ms = MCP3008_TEMP_POLL_MS;
+
+	/* Coefficients are optional; they can also be set through sysfs */
+	device_property_read_u32_array(dev,
+				       "bbb,temp-coeff-microvolt-per-celsius",
+				       (u32 *)adc->temp_coeff,
+				       MCP3008_CHANNELS);
+
+	/* Cancelled on unbind once the IIO device is gone */
+	return devm_delayed_work_autocancel(dev, &adc->temp_work,
+					    mcp3008_temp_work);
+}
+
+static void mcp3008_vref_disable(void *vref)
+{
+	regulator_disable(vref);
+}
 
 /**
  * mcp3008_probe - Initialize the MCP3008 device
+ *
+ * All teardown is devm-managed. Everything the IIO device uses is set up
+ * before it is registered, so on unbind the device and its buffer go
+ * away first, then the temperature work, and vref is disabled last.
  */
 static int mcp3008_probe(struct spi_device *spi)
 {
@@ -119,6 +603,8 @@ static int mcp3008_probe(struct spi_device *spi)
 
 	adc = iio_priv(indio_dev);
 	adc->spi = spi;
+	spin_lock_init(&adc->hist_lock);
+	mutex_init(&adc->hist_alloc_lock);
 
 	/* Get voltage reference (or default to 3.3V) */
 	adc->vref = devm_regulator_get_optional(&spi->dev, "vref");
@@ -134,15 +620,24 @@ static int mcp3008_probe(struct spi_device *spi)
 		if (ret)
 			return ret;
 
+		ret = devm_add_action_or_reset(&spi->dev, mcp3008_vref_disable,
+					       adc->vref);
+		if (ret)
+			return ret;
+
 		ret = regulator_get_voltage(adc->vref);
 		if (ret < 0)
-			goto err_vref_disable;
+			return ret;
 
 		adc->vref_mv = ret / 1000; /* Convert uV to mV */
 	}
 
 	spi_set_drvdata(spi, indio_dev);
 
+	ret = mcp3008_temp_comp_init(adc);
+	if (ret)
+		return ret;
+
 	/* Configure IIO device */
 	indio_dev->name = "mcp3008";
 	indio_dev->modes = INDIO_DIRECT_MODE;
@@ -150,31 +645,26 @@ static int mcp3008_probe(struct spi_device *spi)
 	indio_dev->num_channels = ARRAY_SIZE(mcp3008_channels);
 	indio_dev->info = &mcp3008_info;
 
-	ret = devm_iio_device_register(&spi->dev, indio_dev);
+	ret = mcp3008_debugfs_init(adc);
 	if (ret)
-		goto err_vref_disable;
-
-	dev_info(&spi->dev, "MCP3008 ADC registered (vref=%umV)\n", adc->vref_mv);
-	return 0;
+		return ret;
 
-err_vref_disable:
-	if (!IS_ERR(adc->vref))
-		regulator_disable(adc->vref);
-	return ret;
-}
+	ret = devm_iio_triggered_buffer_setup(&spi->dev, indio_dev,
+					      iio_pollfunc_store_time,
+					      mcp3008_trigger_handler, NULL);
+	if (ret)
+		return ret;
 
-/**
- * mcp3008_remove - Clean up when driver is removed
- */
-static void mcp3008_remove(struct spi_device *spi)
-{
-	struct iio_dev *indio_dev = spi_get_drvdata(spi);
-	struct mcp3008 *adc = iio_priv(indio_dev);
+	ret = devm_iio_device_register(&spi->dev, indio_dev);
+	if (ret)
+		return ret;
 
-	if (!IS_ERR(adc->vref))
-		regulator_disable(adc->vref);
+	if (adc->temp_chan)
+		schedule_delayed_work(&adc->temp_work, 0);
 
-	dev_info(&spi->dev, "MCP3008 ADC removed\n");
+	dev_info(&spi->dev, "MCP3008 ADC registered (vref=%umV, temp comp %s)\n",
+		 adc->vref_mv, adc->temp_chan ? "on" : "off");
+	return 0;
 }
 
 /* Device tree match table */
@@ -187,6 +677,7 @@ MODULE_DEVICE_TABLE(of, mcp3008_dt_ids);
 /* SPI device ID table */
 static const struct spi_device_id mcp3008_id[] = {
 	{ "mcp3008", 0 },
+	{ "bbb-mcp3008-sim", 0 },	/* bbb_mcp3008_sim */
 	{ }
 };
 MODULE_DEVICE_TABLE(spi, mcp3008_id);
@@ -195,9 +686,10 @@ static struct spi_driver mcp3008_driver = {
 	.driver = {
 		.name = "mcp3008",
 		.of_match_table = mcp3008_dt_ids,
+		/* Probed asynchronously at boot; insmod waits unless async_probe=1 */
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = mcp3008_probe,
-	.remove = mcp3008_remove,
 	.id_table = mcp3008_id,
 };
 
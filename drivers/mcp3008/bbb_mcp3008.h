@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * MCP3008 driver internals - shared by bbb_mcp3008 and its KUnit suite
+ *
+ * Author: Chun
+ */
+
+#ifndef BBB_MCP3008_H
+#define BBB_MCP3008_H
+
+#include <linux/atomic.h>
+#include <linux/export.h>
+#include <linux/iio/iio.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+struct dentry;
+struct iio_channel;
+struct regulator;
+struct spi_device;
+
+#define MCP3008_CHANNELS 8
+#define MCP3008_MAX_CODE 1023
+#define MCP3008_CODES (MCP3008_MAX_CODE + 1)
+
+/* Latency histogram: bucket n counts durations in [2^n, 2^(n+1)) ns */
+#define MCP3008_HIST_BUCKETS	32
+
+/*
+ * Transfer statistics, updated lock-free from the conversion path and
+ * exposed in debugfs. Conversion latency covers the whole of
+ * mcp3008_adc_conversion(); bus latency only spi_sync_transfer(), so the
+ * difference is driver overhead.
+ */
+struct mcp3008_stats {
+	atomic64_t conversions;
+	atomic64_t errors;
+	atomic64_t retries;
+	atomic64_t bus_busy_ns;
+	atomic64_t conv_hist[MCP3008_HIST_BUCKETS];
+	atomic64_t bus_hist[MCP3008_HIST_BUCKETS];
+};
+
+/* Driver private data */
+struct mcp3008 {
+	struct spi_device *spi;
+	struct regulator *vref;
+	u16 vref_mv;  /* Reference voltage in millivolts */
+
+	/*
+	 * Optional temperature compensation. The temperature source is any
+	 * IIO temperature channel named "temp" in DT (e.g. bbb_tmp117); its
+	 * value is cached by temp_work so the conversion path never touches
+	 * the other device's bus.
+	 */
+	struct iio_channel *temp_chan;
+	struct delayed_work temp_work;
+	u32 temp_poll_ms;
+	s32 temp_ref_mc;		/* Temperature at which coeff is zero */
+	int temp_mc;			/* Latest cached temperature (m°C) */
+	bool temp_valid;
+	s32 temp_coeff[MCP3008_CHANNELS];	/* Drift in uV per °C */
+
+	struct mcp3008_stats stats;
+
+	/*
+	 * Optional per-channel code histogram for noise analysis. Allocated
+	 * on first enable; hist_lock makes snapshot-and-clear atomic with
+	 * respect to the sampling path.
+	 */
+	u32 (*code_hist)[MCP3008_CODES];	/* kvcalloc, freed with debugfs */
+	bool code_hist_enabled;
+	spinlock_t hist_lock;
+	struct mutex hist_alloc_lock;	/* Serializes enable/allocation */
+	struct mcp3008_hist_file {
+		struct mcp3008 *adc;
+		u8 channel;
+		bool drain;
+	} hist_files[MCP3008_CHANNELS * 2];
+
+	struct dentry *debugfs_dir;
+
+	/* Buffer scan: up to 8 samples plus naturally aligned timestamp */
+	struct {
+		u16 channels[MCP3008_CHANNELS];
+		s64 ts __aligned(8);
+	} scan;
+};
+
+/*
+ * Helpers the KUnit suite (bbb_mcp3008_kunit.ko) calls directly: static
+ * in normal builds, exported to the suite's symbol namespace when it is
+ * enabled. Local stand-ins for <kunit/visibility.h>, which 6.1 lacks.
+ */
+#if IS_ENABLED(CONFIG_BBB_MCP3008_KUNIT_TEST)
+#define VISIBLE_IF_MCP3008_KUNIT
+#define EXPORT_SYMBOL_IF_MCP3008_KUNIT(sym) \
+	EXPORT_SYMBOL_NS_GPL(sym, BBB_MCP3008_KUNIT)
+
+extern unsigned int mcp3008_spi_retries;
+extern const struct iio_chan_spec mcp3008_channels[MCP3008_CHANNELS + 1];
+extern const struct iio_info mcp3008_info;
+
+int mcp3008_adc_conversion(struct mcp3008 *adc, u8 channel);
+int mcp3008_read_scan(struct mcp3008 *adc, const unsigned long *mask,
+		      unsigned int masklength);
+int mcp3008_read_raw(struct iio_dev *indio_dev,
+		     struct iio_chan_spec const *chan,
+		     int *val, int *val2, long mask);
+#else
+#define VISIBLE_IF_MCP3008_KUNIT static
+#define EXPORT_SYMBOL_IF_MCP3008_KUNIT(sym)
+#endif
+
+#endif /* BBB_MCP3008_H */
@@ -0,0 +1,332 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * KUnit tests and micro-benchmarks for the MCP3008 driver
+ *
+ * Built as its own module, bbb_mcp3008_kunit.ko, which calls into
+ * bbb_mcp3008.ko through helpers exported only when
+ * CONFIG_BBB_MCP3008_KUNIT_TEST is enabled (see bbb_mcp3008.h). Each test
+ * gets its own fake SPI controller that records the command bytes the
+ * driver sends and answers with per-channel codes laid out exactly as the
+ * chip clocks them out, undefined high bits included.
+ *
+ * Results: dmesg, or /sys/kernel/debug/kunit/bbb_mcp3008/results
+ *
+ * Author: Chun
+ */
+
+#include <kunit/test.h>
+#include <linux/device.h>
+#include <linux/iio/iio.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/spi/spi.h>
+
+#include "bbb_mcp3008.h"
+
+#define MCP3008_TEST_BENCH_CONVERSIONS	2000
+#define MCP3008_TEST_BENCH_SCANS	250
+
+/* Fake MCP3008 on the far side of the test controller */
+struct mcp3008_test_bus {
+	u8 last_tx[3];
+	u16 code[MCP3008_CHANNELS];
+	unsigned int xfers;
+	int fail;		/* Error returned by every transfer, 0 = none */
+};
+
+struct mcp3008_test_ctx {
+	struct device *root;
+	struct spi_controller *ctlr;
+	struct mcp3008_test_bus *bus;
+	struct iio_dev *indio_dev;
+	struct mcp3008 *adc;
+};
+
+static int mcp3008_test_transfer_one(struct spi_controller *ctlr,
+				     struct spi_device *spi,
+				     struct spi_transfer *xfer)
+{
+	struct mcp3008_test_bus *bus = spi_controller_get_devdata(ctlr);
+	const u8 *tx = xfer->tx_buf;
+	u8 *rx = xfer->rx_buf;
+	u16 code;
+
+	bus->xfers++;
+	if (bus->fail)
+		return bus->fail;
+	if (xfer->len != 3 || !tx || !rx)
+		return -EINVAL;
+
+	memcpy(bus->last_tx, tx, sizeof(bus->last_tx));
+	code = bus->code[(tx[1] >> 4) & 0x07];
+
+	/* Bits before the null bit are undefined on the real chip */
+	rx[0] = 0xff;
+	rx[1] = 0xf8 | ((code >> 8) & 0x03);
+	rx[2] = code & 0xff;
+
+	return 0;	/* Completed synchronously */
+}
+
+static int mcp3008_test_init(struct kunit *test)
+{
+	struct spi_board_info info = {
+		.modalias = "bbb-mcp3008-kunit",	/* Binds no driver */
+		.max_speed_hz = 1000000,
+		.mode = SPI_MODE_0,
+	};
+	struct mcp3008_test_ctx *ctx;
+	struct spi_device *spi;
+	int ret;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx);
+	test->priv = ctx;
+
+	ctx->root = root_device_register("bbb_mcp3008_kunit");
+	KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->root));
+
+	ctx->ctlr = spi_alloc_master(ctx->root, sizeof(*ctx->bus));
+	KUNIT_ASSERT_NOT_NULL(test, ctx->ctlr);
+	ctx->bus = spi_controller_get_devdata(ctx->ctlr);
+
+	ctx->ctlr->bus_num = -1;
+	ctx->ctlr->num_chipselect = 1;
+	ctx->ctlr->mode_bits = SPI_CPOL | SPI_CPHA;
+	ctx->ctlr->bits_per_word_mask = SPI_BPW_MASK(8);
+	ctx->ctlr->transfer_one = mcp3008_test_transfer_one;
+
+	ret = spi_register_controller(ctx->ctlr);
+	if (ret) {
+		spi_controller_put(ctx->ctlr);
+		ctx->ctlr = NULL;
+	}
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	spi = spi_new_device(ctx->ctlr, &info);
+	KUNIT_ASSERT_NOT_NULL(test, spi);
+
+	/* Driver state as probe leaves it without a vref regulator */
+	ctx->indio_dev = iio_device_alloc(&spi->dev, sizeof(*ctx->adc));
+	KUNIT_ASSERT_NOT_NULL(test, ctx->indio_dev);
+	ctx->indio_dev->channels = mcp3008_channels;
+	ctx->indio_dev->num_channels = ARRAY_SIZE(mcp3008_channels);
+	ctx->indio_dev->info = &mcp3008_info;
+
+	ctx->adc = iio_priv(ctx->indio_dev);
+	ctx->adc->spi = spi;
+	ctx->adc->vref = ERR_PTR(-ENODEV);
+	ctx->adc->vref_mv = 3300;
+	spin_lock_init(&ctx->adc->hist_lock);
+	mutex_init(&ctx->adc->hist_alloc_lock);
+
+	return 0;
+}
+
+static void mcp3008_test_exit(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+
+	if (!ctx)
+		return;
+	if (ctx->indio_dev)
+		iio_device_free(ctx->indio_dev);
+	/* Also removes the SPI device */
+	if (ctx->ctlr)
+		spi_unregister_controller(ctx->ctlr);
+	if (!IS_ERR_OR_NULL(ctx->root))
+		root_device_unregister(ctx->root);
+}
+
+/* Start bit, single-ended flag and channel in the top nibble of byte 1 */
+static void mcp3008_test_command_encoding(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	u8 ch;
+
+	for (ch = 0; ch < MCP3008_CHANNELS; ch++) {
+		KUNIT_ASSERT_GE(test, mcp3008_adc_conversion(ctx->adc, ch), 0);
+		KUNIT_EXPECT_EQ_MSG(test, ctx->bus->last_tx[0], 0x01, "ch %u", ch);
+		KUNIT_EXPECT_EQ_MSG(test, ctx->bus->last_tx[1], 0x80 | (ch << 4),
+				    "ch %u", ch);
+		KUNIT_EXPECT_EQ_MSG(test, ctx->bus->last_tx[2], 0x00, "ch %u", ch);
+	}
+
+	KUNIT_EXPECT_EQ(test, ctx->bus->xfers, MCP3008_CHANNELS);
+}
+
+/* Codes exercising B9/B8, the byte boundary and both ends of the range */
+static const u16 mcp3008_test_codes[] = {
+	0, 1, 255, 256, 341, 511, 512, 682, 767, 768, 1022, 1023,
+};
+
+static void mcp3008_test_result_decoding(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	unsigned int i;
+	u8 ch;
+
+	for (i = 0; i < ARRAY_SIZE(mcp3008_test_codes); i++) {
+		for (ch = 0; ch < MCP3008_CHANNELS; ch++)
+			ctx->bus->code[ch] = mcp3008_test_codes[i] ^ (ch * 0x49 & 0x3ff);
+
+		for (ch = 0; ch < MCP3008_CHANNELS; ch++)
+			KUNIT_EXPECT_EQ_MSG(test,
+					    mcp3008_adc_conversion(ctx->adc, ch),
+					    (int)ctx->bus->code[ch],
+					    "ch %u", ch);
+	}
+}
+
+/* The IIO raw attribute goes through the same decoding */
+static void mcp3008_test_read_raw(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	int val = -1, val2 = -1;
+
+	ctx->bus->code[5] = 0x2a5;
+	KUNIT_ASSERT_EQ(test,
+			mcp3008_read_raw(ctx->indio_dev, &mcp3008_channels[5],
+					 &val, &val2, IIO_CHAN_INFO_RAW),
+			IIO_VAL_INT);
+	KUNIT_EXPECT_EQ(test, val, 0x2a5);
+}
+
+static void mcp3008_test_scale(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	int val, val2, ret;
+
+	ret = mcp3008_read_raw(ctx->indio_dev, &mcp3008_channels[0],
+			       &val, &val2, IIO_CHAN_INFO_SCALE);
+	KUNIT_ASSERT_EQ(test, ret, IIO_VAL_FRACTIONAL_LOG2);
+	KUNIT_EXPECT_EQ(test, val, 3300);
+	KUNIT_EXPECT_EQ(test, val2, 10);
+	/* 3300 mV / 1024 = 3.222656250 mV per code */
+	KUNIT_EXPECT_EQ(test, div_u64((u64)val * 1000000000ULL, 1 << val2),
+			3222656250ULL);
+
+	/* A 5 V reference scales the same way */
+	ctx->adc->vref_mv = 5000;
+	ret = mcp3008_read_raw(ctx->indio_dev, &mcp3008_channels[0],
+			       &val, &val2, IIO_CHAN_INFO_SCALE);
+	KUNIT_EXPECT_EQ(test, val, 5000);
+	KUNIT_EXPECT_EQ(test, val2, 10);
+
+	KUNIT_EXPECT_EQ(test, mcp3008_read_raw(ctx->indio_dev,
+					       &mcp3008_channels[0], &val,
+					       &val2, IIO_CHAN_INFO_OFFSET),
+			-EINVAL);
+}
+
+static void mcp3008_test_spi_errors(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	unsigned int saved = mcp3008_spi_retries;
+
+	ctx->bus->fail = -EIO;
+
+	mcp3008_spi_retries = 0;
+	KUNIT_EXPECT_EQ(test, mcp3008_adc_conversion(ctx->adc, 0), -EIO);
+	KUNIT_EXPECT_EQ(test, ctx->bus->xfers, 1);
+
+	mcp3008_spi_retries = 2;
+	KUNIT_EXPECT_EQ(test, mcp3008_adc_conversion(ctx->adc, 0), -EIO);
+	KUNIT_EXPECT_EQ(test, ctx->bus->xfers, 4);
+
+	mcp3008_spi_retries = saved;
+
+	KUNIT_EXPECT_EQ(test, atomic64_read(&ctx->adc->stats.errors), 2);
+	KUNIT_EXPECT_EQ(test, atomic64_read(&ctx->adc->stats.retries), 2);
+	KUNIT_EXPECT_EQ(test, atomic64_read(&ctx->adc->stats.conversions), 0);
+}
+
+/* Enabled channels are packed into the scan in ascending order */
+static void mcp3008_test_scan(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	unsigned long mask = BIT(0) | BIT(2) | BIT(5) | BIT(7);
+	u8 ch;
+
+	for (ch = 0; ch < MCP3008_CHANNELS; ch++)
+		ctx->bus->code[ch] = 100 * ch + 7;
+
+	KUNIT_ASSERT_EQ(test, mcp3008_read_scan(ctx->adc, &mask,
+						MCP3008_CHANNELS), 0);
+	KUNIT_EXPECT_EQ(test, ctx->bus->xfers, 4);
+	KUNIT_EXPECT_EQ(test, ctx->adc->scan.channels[0], 7);
+	KUNIT_EXPECT_EQ(test, ctx->adc->scan.channels[1], 207);
+	KUNIT_EXPECT_EQ(test, ctx->adc->scan.channels[2], 507);
+	KUNIT_EXPECT_EQ(test, ctx->adc->scan.channels[3], 707);
+
+	ctx->bus->fail = -EIO;
+	KUNIT_EXPECT_EQ(test, mcp3008_read_scan(ctx->adc, &mask,
+						MCP3008_CHANNELS), -EIO);
+}
+
+/*
+ * Micro-benchmarks. The fake bus costs only the SPI core's message path,
+ * so the numbers track driver plus SPI core overhead per conversion and
+ * per 8-channel scan; "bus" is the part spent inside spi_sync_transfer().
+ */
+static void mcp3008_test_bench_conversion(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	unsigned int i, n = MCP3008_TEST_BENCH_CONVERSIONS;
+	u64 total_ns, bus_ns;
+	ktime_t start;
+
+	start = ktime_get();
+	for (i = 0; i < n; i++)
+		KUNIT_ASSERT_GE(test, mcp3008_adc_conversion(ctx->adc, i & 7), 0);
+	total_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bus_ns = atomic64_read(&ctx->adc->stats.bus_busy_ns);
+
+	kunit_info(test, "conversion: %llu ns/op (bus %llu ns/op) over %u ops\n",
+		   div_u64(total_ns, n), div_u64(bus_ns, n), n);
+}
+
+static void mcp3008_test_bench_scan(struct kunit *test)
+{
+	struct mcp3008_test_ctx *ctx = test->priv;
+	unsigned long mask = GENMASK(MCP3008_CHANNELS - 1, 0);
+	unsigned int i, n = MCP3008_TEST_BENCH_SCANS;
+	u64 total_ns, bus_ns;
+	ktime_t start;
+
+	start = ktime_get();
+	for (i = 0; i < n; i++)
+		KUNIT_ASSERT_EQ(test, mcp3008_read_scan(ctx->adc, &mask,
+							MCP3008_CHANNELS), 0);
+	total_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bus_ns = atomic64_read(&ctx->adc->stats.bus_busy_ns);
+
+	kunit_info(test, "scan (8 ch): %llu ns/scan (bus %llu ns/scan) over %u scans\n",
+		   div_u64(total_ns, n), div_u64(bus_ns, n), n);
+}
+
+static struct kunit_case mcp3008_test_cases[] = {
+	KUNIT_CASE(mcp3008_test_command_encoding),
+	KUNIT_CASE(mcp3008_test_result_decoding),
+	KUNIT_CASE(mcp3008_test_read_raw),
+	KUNIT_CASE(mcp3008_test_scale),
+	KUNIT_CASE(mcp3008_test_spi_errors),
+	KUNIT_CASE(mcp3008_test_scan),
+	KUNIT_CASE(mcp3008_test_bench_conversion),
+	KUNIT_CASE(mcp3008_test_bench_scan),
+	{ }
+};
+
+static struct kunit_suite mcp3008_test_suite = {
+	.name = "bbb_mcp3008",
+	.init = mcp3008_test_init,
+	.exit = mcp3008_test_exit,
+	.test_cases = mcp3008_test_cases,
+};
+kunit_test_suite(mcp3008_test_suite);
+
+MODULE_IMPORT_NS(BBB_MCP3008_KUNIT);
+MODULE_AUTHOR("Chun");
+MODULE_DESCRIPTION("KUnit tests for the MCP3008 driver");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Software MCP3008 behind a mock SPI controller
+ *
+ * Registers a platform device providing an SPI controller with a single
+ * MCP3008 model on chip select 0. The model decodes the 3-byte command
+ * protocol and answers with a synthetic waveform, so the unmodified
+ * bbb_mcp3008 driver binds to it on any Linux host.
+ *
+ * Usage:
+ *   insmod bbb_mcp3008_sim.ko waveform=sine amplitude=400 period=256
+ *   insmod bbb_mcp3008.ko
+ *
+ * All parameters can be changed at runtime under
+ * /sys/module/bbb_mcp3008_sim/parameters/.
+ *
+ * Author: Chun
+ */
+
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/spi/spi.h>
+#include <linux/fixp-arith.h>
+#include <linux/random.h>
+#include <linux/delay.h>
+#include <linux/atomic.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#define SIM_NAME	"bbb_mcp3008_sim"
+#define SIM_CHANNELS	8
+#define SIM_MAX_CODE	1023
+
+enum mcp3008_sim_waveform {
+	SIM_WAVE_CONSTANT,
+	SIM_WAVE_RAMP,
+	SIM_WAVE_SINE,
+	SIM_WAVE_NOISE,
+};
+
+static const char * const mcp3008_sim_waveforms[] = {
+	[SIM_WAVE_CONSTANT] = "constant",
+	[SIM_WAVE_RAMP] = "ramp",
+	[SIM_WAVE_SINE] = "sine",
+	[SIM_WAVE_NOISE] = "noise",
+};
+
+static int waveform = SIM_WAVE_CONSTANT;
+
+static int mcp3008_sim_waveform_set(const char *val,
+				    const struct kernel_param *kp)
+{
+	int ret = sysfs_match_string(mcp3008_sim_waveforms, val);
+
+	if (ret < 0)
+		return ret;
+
+	WRITE_ONCE(waveform, ret);
+	return 0;
+}
+
+static int mcp3008_sim_waveform_get(char *buf, const struct kernel_param *kp)
+{
+	return sysfs_emit(buf, "%s\n", mcp3008_sim_waveforms[READ_ONCE(waveform)]);
+}
+
+static const struct kernel_param_ops mcp3008_sim_waveform_ops = {
+	.set = mcp3008_sim_waveform_set,
+	.get = mcp3008_sim_waveform_get,
+};
+module_param_cb(waveform, &mcp3008_sim_waveform_ops, NULL, 0644);
+MODULE_PARM_DESC(waveform, "Waveform: constant, ramp, sine or noise");
+
+/* Per-channel level: constant value, or centre for sine and noise */
+static int level[SIM_CHANNELS] = { 512, 512, 512, 512, 512, 512, 512, 512 };
+module_param_array(level, int, NULL, 0644);
+MODULE_PARM_DESC(level, "Per-channel code for constant, centre for sine/noise");
+
+static int amplitude = 256;
+module_param(amplitude, int, 0644);
+MODULE_PARM_DESC(amplitude, "Sine peak or noise half-range in codes");
+
+static unsigned int period = 1024;
+module_param(period, uint, 0644);
+MODULE_PARM_DESC(period, "Ramp/sine period in samples per channel");
+
+static unsigned int latency_us;
+module_param(latency_us, uint, 0644);
+MODULE_PARM_DESC(latency_us, "Extra latency added to every SPI transfer");
+
+struct mcp3008_sim {
+	struct spi_device *spi;
+	atomic_t sample[SIM_CHANNELS];	/* Per-channel sample index */
+};
+
+/**
+ * mcp3008_sim_sample - Produce the next code for a channel
+ * @sim: Simulator state
+ * @channel: Channel number (0-7)
+ *
+ * Channels are phase-shifted by 1/8 period so they are distinguishable.
+ */
+static int mcp3008_sim_sample(struct mcp3008_sim *sim, u8 channel)
+{
+	unsigned int n = atomic_inc_return(&sim->sample[channel]) - 1;
+	unsigned int p = max(READ_ONCE(period), 1U);
+	int centre = READ_ONCE(level[channel]);
+	int amp = READ_ONCE(amplitude);
+	int code;
+
+	n += channel * p / SIM_CHANNELS;
+
+	switch (READ_ONCE(waveform)) {
+	case SIM_WAVE_RAMP:
+		code = div_u64((u64)(n % p) * (SIM_MAX_CODE + 1), p);
+		break;
+	case SIM_WAVE_SINE:
+		code = centre + (int)(((s64)amp *
+			fixp_sin32(div_u64((u64)(n % p) * 360, p))) >> 31);
+		break;
+	case SIM_WAVE_NOISE:
+		code = centre;
+		if (amp > 0)
+			code += (int)(get_random_u32() % (2 * amp + 1)) - amp;
+		break;
+	default:
+		code = centre;
+		break;
+	}
+
+	return clamp(code, 0, SIM_MAX_CODE);
+}
+
+/**
+ * mcp3008_sim_transfer_one - Answer one transfer as an MCP3008 would
+ *
+ * Each 3-byte frame is decoded independently: byte 0 carries the start
+ * bit, byte 1 the single-ended flag and channel. The result is returned
+ * as 0b000000B9B8 / B7..B0 in the last two bytes, matching the real
+ * chip's output alignment. Differential mode is not modelled and reads
+ * as mid-scale.
+ */
+static int mcp3008_sim_transfer_one(struct spi_controller *ctlr,
+				    struct spi_device *spi,
+				    struct spi_transfer *xfer)
+{
+	struct mcp3008_sim *sim = spi_controller_get_devdata(ctlr);
+	const u8 *tx = xfer->tx_buf;
+	u8 *rx = xfer->rx_buf;
+	unsigned int i;
+	int code;
+
+	if (rx)
+		memset(rx, 0, xfer->len);
+
+	for (i = 0; i + 3 <= xfer->len; i += 3) {
+		if (!tx || !(tx[i] & 0x01))
+			continue;	/* No start bit: chip stays idle */
+
+		if (tx[i + 1] & 0x80)
+			code = mcp3008_sim_sample(sim, (tx[i + 1] >> 4) & 0x07);
+		else
+			code = (SIM_MAX_CODE + 1) / 2;
+
+		if (rx) {
+			rx[i + 1] = (code >> 8) & 0x03;
+			rx[i + 2] = code & 0xff;
+		}
+	}
+
+	if (READ_ONCE(latency_us))
+		fsleep(READ_ONCE(latency_us));
+
+	return 0;	/* Transfer completed synchronously */
+}
+
+static int mcp3008_sim_probe(struct platform_device *pdev)
+{
+	struct spi_board_info info = {
+		/* Matched only by bbb_mcp3008, never by upstream mcp320x */
+		.modalias = "bbb-mcp3008-sim",
+		.max_speed_hz = 1000000,
+		.chip_select = 0,
+		.mode = SPI_MODE_0,
+	};
+	struct spi_controller *ctlr;
+	struct mcp3008_sim *sim;
+	int ret;
+
+	ctlr = devm_spi_alloc_master(&pdev->dev, sizeof(*sim));
+	if (!ctlr)
+		return -ENOMEM;
+
+	sim = spi_controller_get_devdata(ctlr);
+
+	ctlr->bus_num = -1;
+	ctlr->num_chipselect = 1;
+	ctlr->mode_bits = SPI_CPOL | SPI_CPHA;
+	ctlr->bits_per_word_mask = SPI_BPW_MASK(8);
+	ctlr->transfer_one = mcp3008_sim_transfer_one;
+
+	ret = devm_spi_register_controller(&pdev->dev, ctlr);
+	if (ret)
+		return dev_err_probe(&pdev->dev, ret,
+				     "failed to register SPI controller\n");
+
+	/* Removed together with the controller */
+	sim->spi = spi_new_device(ctlr, &info);
+	if (!sim->spi)
+		return -ENODEV;
+
+	dev_info(&pdev->dev, "simulated MCP3008 on %s (waveform=%s)\n",
+		 dev_name(&sim->spi->dev), mcp3008_sim_waveforms[waveform]);
+	return 0;
+}
+
+static struct platform_driver mcp3008_sim_driver = {
+	.probe = mcp3008_sim_probe,
+	.driver = {
+		.name = SIM_NAME,
+	},
+};
+
+static struct platform_device *mcp3008_sim_pdev;
+
+static int __init mcp3008_sim_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&mcp3008_sim_driver);
+	if (ret)
+		return ret;
+
+	mcp3008_sim_pdev = platform_device_register_simple(SIM_NAME, -1,
+							   NULL, 0);
+	if (IS_ERR(mcp3008_sim_pdev)) {
+		platform_driver_unregister(&mcp3008_sim_driver);
+		return PTR_ERR(mcp3008_sim_pdev);
+	}
+
+	return 0;
+}
+module_init(mcp3008_sim_init);
+
+static void __exit mcp3008_sim_exit(void)
+{
+	platform_device_unregister(mcp3008_sim_pdev);
+	platform_driver_unregister(&mcp3008_sim_driver);
+}
+module_exit(mcp3008_sim_exit);
+
+MODULE_AUTHOR("Chun");
+MODULE_DESCRIPTION("Simulated MCP3008 ADC behind a mock SPI controller");
+MODULE_LICENSE("GPL");
@@ -1,78 +1,957 @@
 #include <linux/module.h>
 #include <linux/i2c.h>
 #include <linux/hwmon.h>
+#include <linux/regmap.h>
+#include <linux/bitfield.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/property.h>
+#include <linux/util_macros.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/wait.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/devm-helpers.h>
+#include <linux/thermal.h>
+#include <linux/debugfs.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/overflow.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#include "bbb_tmp117.h"
 
-// Register definitions
-#define TMP117_REG_TEMP        0x00  // Temperature result register
-#define TMP117_REG_CONFIG      0x01  // Configuration register
-#define TMP117_REG_DEVICE_ID   0x0F  // Device ID register
+// Selectable update intervals (ms), using the most averaging that still
+// fits each cycle. Must stay sorted for find_closest().
+static const int bbb_tmp117_interval_ms[] = {
+	16, 125, 250, 500, 1000, 4000, 8000, 16000
+};
+
+static const u8 bbb_tmp117_interval_conv[] = { 0, 0, 2, 0, 0, 5, 6, 7 };
+static const u8 bbb_tmp117_interval_avg[]  = { 0, 1, 1, 2, 3, 3, 3, 3 };
+
+// One-shot wait margin over the typical conversion time: 1/8 (12.5 %)
+#define TMP117_ONESHOT_MARGIN_SHIFT  3
+
+// History ring upper bound: 64k entries, 1 MiB
+#define TMP117_HISTORY_MAX  65536
+
+// dT/dt filter: EMA with alpha = 1/4. Instantaneous slopes are clamped to
+// +/-1000 C/s so two samples close together cannot swamp the average.
+#define TMP117_SLOPE_EMA_SHIFT  2
+#define TMP117_SLOPE_CLAMP      1000000
+
+// Driver-private bit in the alarm change mask, above the hwmon attributes
+#define TMP117_SLOPE_ALARM      BIT(31)
 
-// Device ID
-#define TMP117_DEVICE_ID       0x0117
+// Specified operating range; a limit outside it can never be crossed
+#define TMP117_TEMP_MIN_MC      (-55000)
+#define TMP117_TEMP_MAX_MC      150000
 
-// Resolution: 7.8125 mC/LSB = 78125 uC / 10000
-#define TMP117_RESOLUTION_NUM  78125
-#define TMP117_RESOLUTION_DEN  10000
+static unsigned int history_len;
+module_param(history_len, uint, 0444);
+MODULE_PARM_DESC(history_len,
+		 "Samples kept in the debugfs history ring, rounded up to a power of two (default 0 = off)");
 
-// Driver private data structure
+// Driver private data structure (lives in the IIO device's private area)
 struct bbb_tmp117_data {
 	struct i2c_client *client;
+	struct regmap *regmap;
+	struct iio_dev *indio_dev;
+	struct iio_trigger *trig;  // Data-ready trigger, NULL without ALERT irq
+	struct mutex lock;     // Protects the cached sample
+	s16 raw;               // Last temperature result
+	ktime_t last_update;   // When raw was read from the chip
+	bool valid;            // raw holds a sample from the current config
+	int irq;               // ALERT in data-ready mode, 0 if not wired
+	wait_queue_head_t wait;  // Woken for every new sample from the IRQ
+	unsigned int seq;      // Incremented for every sample from the IRQ
+	s64 irq_ts;            // IIO timestamp of the last data-ready edge
+
+	// One-shot mode: the chip stays in shutdown between reads
+	bool oneshot;
+	struct mutex oneshot_lock;  // Serializes one-shot conversions
+	ktime_t conv_start;    // When the last one-shot was started
+
+	// Limit alarms, evaluated on every new sample (under lock)
+	struct device *hwmon_dev;  // For alarm notifications, NULL once removed
+	struct mutex notify_lock;  // Protects hwmon_dev
+	s16 thigh;             // Cached THIGH
+	s16 tlow;              // Cached TLOW
+	bool max_alarm;        // Last sample above THIGH
+	bool min_alarm;        // Last sample below TLOW
+	int limit_irq;         // ALERT in limit alert mode, 0 if unused
+	struct delayed_work alarm_work;  // Re-checks an active alarm
+
+	// Thermal zone whose trip window is programmed into THIGH/TLOW,
+	// NULL if none or once detached (written under notify_lock)
+	struct thermal_zone_device *tz;
+	struct work_struct tz_work;  // Zone update after a limit crossing
+
+	// History ring of every stored sample (under lock), NULL if disabled
+	struct tmp117_history_entry *hist;
+	unsigned int hist_mask;  // Ring size - 1, size is a power of two
+	u64 hist_head;         // Samples stored so far
+	struct dentry *debugfs_dir;  // Holds the history file, NULL if disabled
+	struct delayed_work sample_work;  // Samples at the conversion rate when no irq does
+	bool sampler_on;       // Between probe and unbind (under lock)
+
+	// Rate of change over successive samples (under lock)
+	s32 slope_acc;         // EMA of dT/dt in mC/s, scaled by 2^SHIFT
+	s32 slope;             // Filtered dT/dt in mC/s
+	int slope_max;         // Slope alarm threshold in mC/s, 0 = off
+	bool slope_alarm;      // slope above slope_max
+
+	// Buffer scan: one sample plus naturally aligned timestamp
+	struct {
+		s16 temp;
+		s64 ts __aligned(8);
+	} scan;
 };
 
+static bool bbb_tmp117_readable_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case TMP117_REG_TEMP:
+	case TMP117_REG_CONFIG:
+	case TMP117_REG_THIGH:
+	case TMP117_REG_TLOW:
+	case TMP117_REG_TEMP_OFFSET:
+	case TMP117_REG_DEVICE_ID:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool bbb_tmp117_writeable_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case TMP117_REG_CONFIG:
+	case TMP117_REG_THIGH:
+	case TMP117_REG_TLOW:
+	case TMP117_REG_TEMP_OFFSET:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Only the result changes behind our back. The status flags in CONFIG do
+// too, but they are clear-on-read and only fetched with a direct bus read
+// in limit alert mode; the cached copy is only used for the mode fields.
+static bool bbb_tmp117_volatile_reg(struct device *dev, unsigned int reg)
+{
+	return reg == TMP117_REG_TEMP;
+}
+
+// 8-bit pointer, 16-bit big-endian registers
+static const struct regmap_config bbb_tmp117_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 16,
+	.val_format_endian = REGMAP_ENDIAN_BIG,
+	.max_register = TMP117_REG_DEVICE_ID,
+	.readable_reg = bbb_tmp117_readable_reg,
+	.writeable_reg = bbb_tmp117_writeable_reg,
+	.volatile_reg = bbb_tmp117_volatile_reg,
+	.cache_type = REGCACHE_RBTREE,
+};
+
+// Current conversion period, derived from the CONV/AVG bits; in one-shot
+// mode, the conversion time for the configured averaging.
+// CONFIG is served from the register cache, so this costs no bus access.
+static u32 bbb_tmp117_cycle_time_us(struct bbb_tmp117_data *data)
+{
+	unsigned int config = 0;
+
+	regmap_read(data->regmap, TMP117_REG_CONFIG, &config);
+
+	if (data->oneshot)
+		return tmp117_conversion_time_us(config);
+
+	return tmp117_cycle_time_us(config);
+}
+
+// Update CONFIG bits through the register cache. In one-shot mode the
+// cached MOD field may still read one-shot from the last conversion, and
+// writing that back would start a stray conversion, so MOD is written as
+// shutdown along with the requested bits.
+static int bbb_tmp117_update_config(struct bbb_tmp117_data *data,
+				    unsigned int mask, unsigned int val)
+{
+	if (data->oneshot) {
+		mask |= TMP117_CONFIG_MOD;
+		val = (val & ~TMP117_CONFIG_MOD) |
+		      FIELD_PREP(TMP117_CONFIG_MOD, TMP117_MOD_SHUTDOWN);
+	}
+
+	return regmap_update_bits(data->regmap, TMP117_REG_CONFIG, mask, val);
+}
+
+// Compare a new sample against the limits; hardware alert flags from
+// CONFIG count as well. Must hold data->lock.
+// Returns a mask of the alarm attributes that changed.
+static u32 bbb_tmp117_check_alarms(struct bbb_tmp117_data *data, s16 raw,
+				   unsigned int flags)
+{
+	bool max_alarm = raw > data->thigh || (flags & TMP117_CONFIG_HIGH_ALERT);
+	bool min_alarm = raw < data->tlow || (flags & TMP117_CONFIG_LOW_ALERT);
+	u32 changed = 0;
+
+	if (max_alarm != data->max_alarm)
+		changed |= BIT(hwmon_temp_max_alarm);
+	if (min_alarm != data->min_alarm)
+		changed |= BIT(hwmon_temp_min_alarm);
+
+	data->max_alarm = max_alarm;
+	data->min_alarm = min_alarm;
+	return changed;
+}
+
+// Fold the step from the cached sample to a new one into the filtered
+// dT/dt. Must hold data->lock, with data->raw valid.
+static void bbb_tmp117_update_slope(struct bbb_tmp117_data *data, s16 raw,
+				    ktime_t now)
+{
+	s64 dt_ns = ktime_to_ns(ktime_sub(now, data->last_update));
+	s64 inst;
+
+	if (dt_ns <= 0)
+		return;
+
+	inst = div64_s64((s64)(tmp117_raw_to_mc(raw) -
+			       tmp117_raw_to_mc(data->raw)) * NSEC_PER_SEC,
+			 dt_ns);
+	inst = clamp_t(s64, inst, -TMP117_SLOPE_CLAMP, TMP117_SLOPE_CLAMP);
+
+	data->slope_acc += (s32)inst - (data->slope_acc >> TMP117_SLOPE_EMA_SHIFT);
+	data->slope = data->slope_acc >> TMP117_SLOPE_EMA_SHIFT;
+}
+
+// Must hold data->lock. Returns TMP117_SLOPE_ALARM if the alarm changed.
+static u32 bbb_tmp117_check_slope(struct bbb_tmp117_data *data)
+{
+	bool alarm = data->slope_max && data->slope > data->slope_max;
+
+	if (alarm == data->slope_alarm)
+		return 0;
+
+	data->slope_alarm = alarm;
+	return TMP117_SLOPE_ALARM;
+}
+
+// Record a result freshly read from the chip: update the slope and the
+// cache, append it to the history ring and evaluate the alarms. Must hold
+// data->lock. Returns a mask of the alarm attributes that changed.
+static u32 bbb_tmp117_store_sample(struct bbb_tmp117_data *data, s16 raw,
+				   unsigned int flags)
+{
+	ktime_t now = ktime_get();
+
+	// No slope across a config change, the previous sample is stale
+	if (data->valid)
+		bbb_tmp117_update_slope(data, raw, now);
+
+	data->raw = raw;
+	data->last_update = now;
+	data->valid = true;
+	data->seq++;
+
+	if (data->hist) {
+		struct tmp117_history_entry *e;
+
+		e = &data->hist[data->hist_head++ & data->hist_mask];
+		e->ts_ns = ktime_to_ns(data->last_update);
+		e->mc = tmp117_raw_to_mc(raw);
+		e->seq = data->seq;
+	}
+
+	return bbb_tmp117_check_alarms(data, raw, flags) |
+	       bbb_tmp117_check_slope(data);
+}
+
+// Wake poll() waiters on the alarm attributes that changed, and let the
+// thermal zone re-evaluate its trips. Called without data->lock held.
+static void bbb_tmp117_notify_alarms(struct bbb_tmp117_data *data, u32 changed)
+{
+	if (!changed)
+		return;
+
+	// Interrupts and works outlive the hwmon device and the zone on
+	// removal
+	mutex_lock(&data->notify_lock);
+
+	// The limits are the zone's trip window, so a changed alarm means a
+	// trip was crossed. Deferred: the update calls back into get_temp.
+	if (data->tz && (changed & ~TMP117_SLOPE_ALARM))
+		schedule_work(&data->tz_work);
+
+	if (!data->hwmon_dev)
+		goto unlock;
+
+	if (changed & TMP117_SLOPE_ALARM)
+		sysfs_notify(&data->hwmon_dev->kobj, NULL, "temp1_slope_alarm");
+	if (changed & BIT(hwmon_temp_max_alarm))
+		hwmon_notify_event(data->hwmon_dev, hwmon_temp,
+				   hwmon_temp_max_alarm, 0);
+	if (changed & BIT(hwmon_temp_min_alarm))
+		hwmon_notify_event(data->hwmon_dev, hwmon_temp,
+				   hwmon_temp_min_alarm, 0);
+unlock:
+	mutex_unlock(&data->notify_lock);
+}
+
+// Runs before the hwmon device is unregistered
+static void bbb_tmp117_hwmon_detach(void *arg)
+{
+	struct bbb_tmp117_data *data = arg;
+
+	mutex_lock(&data->notify_lock);
+	data->hwmon_dev = NULL;
+	mutex_unlock(&data->notify_lock);
+}
+
+// Fresh-on-read conversion in one-shot mode
+//
+// Starts one conversion through the MOD bits and waits for it, either
+// for the data-ready interrupt or on an absolute hrtimer deadline of the
+// conversion time plus 12.5 %. Worst-case read latency is therefore
+// t_conv(AVG) * 9/8 plus two I2C transactions (config write, result
+// read): about 18 ms without averaging, 1.13 s with 64 averages.
+//
+// A reader that finds a conversion started after it arrived reuses that
+// result instead of starting another one.
+static int bbb_tmp117_read_oneshot(struct bbb_tmp117_data *data, s16 *val)
+{
+	ktime_t arrival = ktime_get();
+	unsigned int reg_val, seq;
+	ktime_t start, deadline;
+	u32 changed, conv_us;
+	int ret = 0;
+
+	mutex_lock(&data->oneshot_lock);
+
+	if (data->valid && ktime_after(data->conv_start, arrival)) {
+		*val = data->raw;
+		goto unlock;
+	}
+
+	conv_us = bbb_tmp117_cycle_time_us(data);
+	seq = READ_ONCE(data->seq);
+
+	// The chip returns to shutdown by itself after the conversion. The
+	// cached MOD field keeps the one-shot value, so force the write.
+	ret = regmap_write_bits(data->regmap, TMP117_REG_CONFIG,
+				TMP117_CONFIG_MOD,
+				FIELD_PREP(TMP117_CONFIG_MOD, TMP117_MOD_ONE_SHOT));
+	if (ret)
+		goto unlock;
+
+	start = ktime_get();
+	conv_us += conv_us >> TMP117_ONESHOT_MARGIN_SHIFT;
+
+	if (data->irq) {
+		// The IRQ thread fetches the result and bumps seq
+		if (!wait_event_timeout(data->wait, READ_ONCE(data->seq) != seq,
+					usecs_to_jiffies(2 * conv_us))) {
+			ret = -ETIMEDOUT;
+			goto unlock;
+		}
+
+		mutex_lock(&data->lock);
+		*val = data->raw;
+		data->conv_start = start;
+		mutex_unlock(&data->lock);
+		goto unlock;
+	}
+
+	deadline = ktime_add_us(start, conv_us);
+	do {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+	} while (schedule_hrtimeout_range(&deadline, 0, HRTIMER_MODE_ABS));
+
+	ret = regmap_read(data->regmap, TMP117_REG_TEMP, &reg_val);
+	if (ret)
+		goto unlock;
+
+	mutex_lock(&data->lock);
+	data->conv_start = start;
+	changed = bbb_tmp117_store_sample(data, (s16)reg_val, 0);
+	mutex_unlock(&data->lock);
+
+	bbb_tmp117_notify_alarms(data, changed);
+	*val = (s16)reg_val;
+unlock:
+	mutex_unlock(&data->oneshot_lock);
+	return ret;
+}
+
+// Get the latest raw temperature result
+//
+// The chip only produces a new result once per conversion cycle, so a
+// sample younger than one cycle is served from the cache. Bus traffic is
+// then bounded by the conversion rate, not by the number of readers.
+// With the ALERT interrupt wired, the cache is refreshed by the IRQ and
+// reads never touch the bus.
+static int bbb_tmp117_read_raw_temp(struct bbb_tmp117_data *data, s16 *val)
+{
+	struct i2c_client *client = data->client;
+	unsigned int reg_val;
+	u32 changed = 0;
+	ktime_t now;
+	int ret;
+	s16 raw;
+
+	if (data->oneshot)
+		return bbb_tmp117_read_oneshot(data, val);
+
+	// After a config change, wait for the first sample at the new rate
+	if (data->irq && !READ_ONCE(data->valid))
+		wait_event_timeout(data->wait, READ_ONCE(data->valid),
+				   usecs_to_jiffies(2 * bbb_tmp117_cycle_time_us(data)));
+
+	mutex_lock(&data->lock);
+	now = ktime_get();
+
+	if (data->valid &&
+	    (data->irq ||
+	     ktime_us_delta(now, data->last_update) < bbb_tmp117_cycle_time_us(data))) {
+		raw = data->raw;
+		goto out;
+	}
+
+	if (data->irq)
+		dev_warn_once(&client->dev, "no data-ready interrupt, reading directly\n");
+
+	ret = regmap_read(data->regmap, TMP117_REG_TEMP, &reg_val);
+	if (ret) {
+		mutex_unlock(&data->lock);
+		dev_err(&client->dev, "Failed to read temperature: %d\n", ret);
+		return ret;
+	}
+
+	raw = (s16)reg_val;
+	changed = bbb_tmp117_store_sample(data, raw, 0);
+out:
+	mutex_unlock(&data->lock);
+
+	bbb_tmp117_notify_alarms(data, changed);
+	*val = raw;
+	return 0;
+}
+
 // Read temperature from sensor (returns millidegrees Celsius)
 static int bbb_tmp117_read_temperature(struct bbb_tmp117_data *data, long *val)
 {
+	s16 raw;
+	int ret;
+
+	ret = bbb_tmp117_read_raw_temp(data, &raw);
+	if (ret)
+		return ret;
+
+	*val = tmp117_raw_to_mc(raw);
+
+	return 0;
+}
+
+// Timestamp the data-ready edge before the threaded handler runs
+static irqreturn_t bbb_tmp117_alert_hardirq(int irq, void *dev_id)
+{
+	struct bbb_tmp117_data *data = dev_id;
+
+	data->irq_ts = iio_get_time_ns(data->indio_dev);
+	return IRQ_WAKE_THREAD;
+}
+
+// Fetch a new result on every data-ready interrupt. Reading the result
+// register clears Data_Ready and releases the ALERT pin.
+static irqreturn_t bbb_tmp117_alert_irq(int irq, void *dev_id)
+{
+	struct bbb_tmp117_data *data = dev_id;
 	struct i2c_client *client = data->client;
-	int reg_val;
+	unsigned int reg_val;
+	u32 changed;
+	int ret;
+
+	ret = regmap_read(data->regmap, TMP117_REG_TEMP, &reg_val);
+	if (ret) {
+		dev_err_ratelimited(&client->dev,
+				    "Failed to read temperature: %d\n", ret);
+		return IRQ_HANDLED;
+	}
+
+	mutex_lock(&data->lock);
+	changed = bbb_tmp117_store_sample(data, (s16)reg_val, 0);
+	mutex_unlock(&data->lock);
+
+	wake_up_all(&data->wait);
+	bbb_tmp117_notify_alarms(data, changed);
+
+	// Push the sample to the IIO buffer if it runs on our trigger
+	if (data->trig)
+		iio_trigger_poll_chained(data->trig);
+
+	return IRQ_HANDLED;
+}
+
+// Route data-ready to the ALERT pin and request its interrupt
+static int bbb_tmp117_setup_irq(struct bbb_tmp117_data *data)
+{
+	struct i2c_client *client = data->client;
+	u32 trigger = irq_get_trigger_type(client->irq);
+	unsigned int pol = 0;
+	int ret;
+
+	if (trigger & (IRQ_TYPE_LEVEL_HIGH | IRQ_TYPE_EDGE_RISING))
+		pol = TMP117_CONFIG_POL;
+
+	ret = bbb_tmp117_update_config(data,
+				       TMP117_CONFIG_DR_ALERT | TMP117_CONFIG_POL,
+				       TMP117_CONFIG_DR_ALERT | pol);
+	if (ret)
+		return ret;
+
+	ret = devm_request_threaded_irq(&client->dev, client->irq,
+					bbb_tmp117_alert_hardirq,
+					bbb_tmp117_alert_irq, IRQF_ONESHOT,
+					"bbb_tmp117", data);
+	if (ret)
+		return ret;
+
+	data->irq = client->irq;
+
+	// Clear a data-ready flag raised before the handler was installed,
+	// otherwise an edge-triggered line would never fire again
+	data->irq_ts = iio_get_time_ns(data->indio_dev);
+	bbb_tmp117_alert_irq(data->irq, data);
+	return 0;
+}
+
+// Resample after a limit alert. Reading CONFIG returns and clears the
+// HIGH/LOW_Alert flags and releases the ALERT pin; it has to bypass the
+// register cache, so it goes to the bus directly.
+static void bbb_tmp117_limit_check(struct bbb_tmp117_data *data)
+{
+	struct i2c_client *client = data->client;
+	unsigned int reg_val;
+	bool active;
+	u32 changed;
+	int flags, ret;
+
+	flags = i2c_smbus_read_word_swapped(client, TMP117_REG_CONFIG);
+	if (flags < 0) {
+		dev_err_ratelimited(&client->dev,
+				    "Failed to read alert flags: %d\n", flags);
+		return;
+	}
+
+	ret = regmap_read(data->regmap, TMP117_REG_TEMP, &reg_val);
+	if (ret) {
+		dev_err_ratelimited(&client->dev,
+				    "Failed to read temperature: %d\n", ret);
+		return;
+	}
+
+	mutex_lock(&data->lock);
+	changed = bbb_tmp117_store_sample(data, (s16)reg_val, flags);
+	active = data->max_alarm || data->min_alarm;
+	mutex_unlock(&data->lock);
+
+	bbb_tmp117_notify_alarms(data, changed);
+
+	// Alert mode only interrupts while a limit is exceeded. Keep checking
+	// once the interrupts stop, so the alarm clears when back in range.
+	if (active)
+		mod_delayed_work(system_wq, &data->alarm_work,
+				 usecs_to_jiffies(2 * bbb_tmp117_cycle_time_us(data)));
+}
+
+static irqreturn_t bbb_tmp117_limit_irq(int irq, void *dev_id)
+{
+	bbb_tmp117_limit_check(dev_id);
+	return IRQ_HANDLED;
+}
+
+static void bbb_tmp117_alarm_work(struct work_struct *work)
+{
+	struct bbb_tmp117_data *data = container_of(to_delayed_work(work),
+						    struct bbb_tmp117_data,
+						    alarm_work);
+
+	bbb_tmp117_limit_check(data);
+}
+
+// Put the ALERT pin in alert mode: asserted after every conversion
+// outside [TLOW, THIGH], so alarms need no polling at all
+static int bbb_tmp117_setup_limit_irq(struct bbb_tmp117_data *data)
+{
+	struct i2c_client *client = data->client;
+	u32 trigger = irq_get_trigger_type(client->irq);
+	unsigned int pol = 0;
+	int ret;
+
+	if (trigger & (IRQ_TYPE_LEVEL_HIGH | IRQ_TYPE_EDGE_RISING))
+		pol = TMP117_CONFIG_POL;
+
+	ret = bbb_tmp117_update_config(data,
+				       TMP117_CONFIG_DR_ALERT | TMP117_CONFIG_TNA |
+				       TMP117_CONFIG_POL, pol);
+	if (ret)
+		return ret;
+
+	ret = devm_delayed_work_autocancel(&client->dev, &data->alarm_work,
+					   bbb_tmp117_alarm_work);
+	if (ret)
+		return ret;
+
+	ret = devm_request_threaded_irq(&client->dev, client->irq, NULL,
+					bbb_tmp117_limit_irq, IRQF_ONESHOT,
+					"bbb_tmp117", data);
+	if (ret)
+		return ret;
+
+	data->limit_irq = client->irq;
+
+	// Release a pin asserted before the handler was installed
+	bbb_tmp117_limit_check(data);
+	return 0;
+}
+
+// A limit inside the operating range, whose alarm only a fresh sample
+// can raise when no interrupt reports the crossing
+static bool bbb_tmp117_limits_armed(struct bbb_tmp117_data *data)
+{
+	return !data->limit_irq &&
+	       (READ_ONCE(data->thigh) < tmp117_mc_to_raw(TMP117_TEMP_MAX_MC) ||
+		READ_ONCE(data->tlow) > tmp117_mc_to_raw(TMP117_TEMP_MIN_MC));
+}
+
+// Samples must be taken at the conversion rate for the history ring, the
+// slope alarm and the limit alarms. The data-ready irq does this by
+// itself; one-shot mode only converts on request, so its alarms follow
+// the requested conversions. Must hold data->lock.
+static bool bbb_tmp117_sampler_needed(struct bbb_tmp117_data *data)
+{
+	return data->sampler_on && !data->irq && !data->oneshot &&
+	       (data->hist || READ_ONCE(data->slope_max) ||
+		bbb_tmp117_limits_armed(data));
+}
+
+// Read once per conversion cycle while the sampler is needed. Reads within
+// a cycle hit the cache and store nothing, so this never adds bus traffic
+// beyond one read per conversion.
+static void bbb_tmp117_sample_work(struct work_struct *work)
+{
+	struct bbb_tmp117_data *data = container_of(to_delayed_work(work),
+						    struct bbb_tmp117_data,
+						    sample_work);
 	s16 raw;
 
-	reg_val = i2c_smbus_read_word_data(client, TMP117_REG_TEMP);
-	if (reg_val < 0) {
-		dev_err(&client->dev, "Failed to read temperature: %d\n", reg_val);
-		return reg_val;
+	bbb_tmp117_read_raw_temp(data, &raw);
+
+	mutex_lock(&data->lock);
+	if (bbb_tmp117_sampler_needed(data))
+		schedule_delayed_work(&data->sample_work,
+				      usecs_to_jiffies(bbb_tmp117_cycle_time_us(data)));
+	mutex_unlock(&data->lock);
+}
+
+static void bbb_tmp117_sampler_kick(struct bbb_tmp117_data *data)
+{
+	mutex_lock(&data->lock);
+	if (bbb_tmp117_sampler_needed(data))
+		schedule_delayed_work(&data->sample_work, 0);
+	mutex_unlock(&data->lock);
+}
+
+// Runs before the thermal zone and the history ring are torn down. The
+// flag keeps hwmon and thermal callbacks still running from requeueing.
+static void bbb_tmp117_sampler_stop(void *arg)
+{
+	struct bbb_tmp117_data *data = arg;
+
+	mutex_lock(&data->lock);
+	data->sampler_on = false;
+	mutex_unlock(&data->lock);
+
+	cancel_delayed_work_sync(&data->sample_work);
+}
+
+// Start sampling once everything the sampler uses is set up
+static int bbb_tmp117_sampler_start(struct bbb_tmp117_data *data)
+{
+	int ret;
+
+	ret = devm_add_action_or_reset(&data->client->dev,
+				       bbb_tmp117_sampler_stop, data);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->lock);
+	data->sampler_on = true;
+	mutex_unlock(&data->lock);
+
+	bbb_tmp117_sampler_kick(data);
+	return 0;
+}
+
+// Program a limit register (millidegrees) and re-evaluate its alarm
+static int bbb_tmp117_set_limit(struct bbb_tmp117_data *data, u32 attr,
+				long val)
+{
+	s16 raw = tmp117_mc_to_raw(val);
+	u32 changed = 0;
+	int ret;
+
+	mutex_lock(&data->lock);
+
+	ret = regmap_write(data->regmap, attr == hwmon_temp_max ?
+			   TMP117_REG_THIGH : TMP117_REG_TLOW, (u16)raw);
+	if (!ret) {
+		if (attr == hwmon_temp_max)
+			data->thigh = raw;
+		else
+			data->tlow = raw;
+
+		if (data->valid)
+			changed = bbb_tmp117_check_alarms(data, data->raw, 0);
 	}
 
-	// TMP117 is big-endian, SMBus returns little-endian - swap bytes
-	raw = swab16(reg_val);
+	mutex_unlock(&data->lock);
+
+	bbb_tmp117_notify_alarms(data, changed);
+	if (!ret)
+		bbb_tmp117_sampler_kick(data);
+	return ret;
+}
+
+// Program CONV/AVG for the closest supported update interval
+static int bbb_tmp117_set_update_interval(struct bbb_tmp117_data *data,
+					  long interval_ms)
+{
+	unsigned int idx;
+	int ret;
+
+	idx = find_closest(interval_ms, bbb_tmp117_interval_ms,
+			   ARRAY_SIZE(bbb_tmp117_interval_ms));
+
+	// Don't cut short a one-shot conversion in flight
+	mutex_lock(&data->oneshot_lock);
+	mutex_lock(&data->lock);
 
-	// Convert to millidegrees Celsius: raw * 7.8125 mC
-	// = raw * 78125 / 10000 (using integer math)
-	*val = ((long)raw * TMP117_RESOLUTION_NUM) / TMP117_RESOLUTION_DEN;
+	ret = bbb_tmp117_update_config(data,
+				       TMP117_CONFIG_CONV | TMP117_CONFIG_AVG,
+				       FIELD_PREP(TMP117_CONFIG_CONV,
+						  bbb_tmp117_interval_conv[idx]) |
+				       FIELD_PREP(TMP117_CONFIG_AVG,
+						  bbb_tmp117_interval_avg[idx]));
+	if (!ret)
+		data->valid = false;  // Next read fetches a sample at the new rate
 
+	mutex_unlock(&data->lock);
+	mutex_unlock(&data->oneshot_lock);
+	return ret;
+}
+
+// Thermal zone: report the cached or freshly read temperature
+static int bbb_tmp117_tz_get_temp(struct thermal_zone_device *tz, int *temp)
+{
+	struct bbb_tmp117_data *data = tz->devdata;
+	long val;
+	int ret;
+
+	ret = bbb_tmp117_read_temperature(data, &val);
+	if (ret)
+		return ret;
+
+	*temp = val;
 	return 0;
 }
 
+// Thermal zone: move the hardware limits to the trips around the current
+// temperature. Leaving the window raises an alarm, which updates the zone.
+static int bbb_tmp117_tz_set_trips(struct thermal_zone_device *tz,
+				   int low, int high)
+{
+	struct bbb_tmp117_data *data = tz->devdata;
+	int ret;
+
+	ret = bbb_tmp117_set_limit(data, hwmon_temp_min, low);
+	if (ret)
+		return ret;
+
+	return bbb_tmp117_set_limit(data, hwmon_temp_max, high);
+}
+
+static const struct thermal_zone_device_ops bbb_tmp117_tz_ops = {
+	.get_temp = bbb_tmp117_tz_get_temp,
+	.set_trips = bbb_tmp117_tz_set_trips,
+};
+
+static void bbb_tmp117_tz_work(struct work_struct *work)
+{
+	struct bbb_tmp117_data *data = container_of(work,
+						    struct bbb_tmp117_data,
+						    tz_work);
+	struct thermal_zone_device *tz = READ_ONCE(data->tz);
+
+	// Detached: the zone is about to be unregistered
+	if (tz)
+		thermal_zone_device_update(tz, THERMAL_EVENT_UNSPECIFIED);
+}
+
+// Runs before the thermal zone is unregistered. With tz cleared under
+// notify_lock nothing queues tz_work any more, so the cancel is final
+// and the zone stays registered until the last update has finished.
+static void bbb_tmp117_tz_detach(void *arg)
+{
+	struct bbb_tmp117_data *data = arg;
+
+	mutex_lock(&data->notify_lock);
+	WRITE_ONCE(data->tz, NULL);
+	mutex_unlock(&data->notify_lock);
+
+	cancel_work_sync(&data->tz_work);
+}
+
+// Register with the thermal zone that references this sensor in DT, if
+// any. Must come before the ALERT interrupt, so that on removal the irq
+// is gone before the work is cancelled and the zone unregistered.
+static int bbb_tmp117_setup_thermal(struct bbb_tmp117_data *data)
+{
+	struct device *dev = &data->client->dev;
+	struct thermal_zone_device *tz;
+
+	if (!IS_ENABLED(CONFIG_THERMAL_OF))
+		return 0;
+
+	INIT_WORK(&data->tz_work, bbb_tmp117_tz_work);
+
+	tz = devm_thermal_of_zone_register(dev, 0, data, &bbb_tmp117_tz_ops);
+	if (IS_ERR(tz)) {
+		if (PTR_ERR(tz) == -ENODEV)
+			return 0;  // No zone uses this sensor
+		return PTR_ERR(tz);
+	}
+
+	mutex_lock(&data->notify_lock);
+	data->tz = tz;
+	mutex_unlock(&data->notify_lock);
+
+	return devm_add_action_or_reset(dev, bbb_tmp117_tz_detach, data);
+}
+
 // hwmon read callback
 static int bbb_tmp117_read(struct device *dev, enum hwmon_sensor_types type,
 			   u32 attr, int channel, long *val)
 {
 	struct bbb_tmp117_data *data = dev_get_drvdata(dev);
 
-	if (type != hwmon_temp || attr != hwmon_temp_input || channel != 0)
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval) {
+		unsigned int config = 0;
+
+		// The programmed CONV/AVG interval, also in one-shot mode,
+		// where only AVG sets the (shorter) conversion time
+		regmap_read(data->regmap, TMP117_REG_CONFIG, &config);
+		*val = DIV_ROUND_CLOSEST(tmp117_cycle_time_us(config), 1000);
+		return 0;
+	}
+
+	if (type != hwmon_temp || channel != 0)
 		return -EOPNOTSUPP;
 
-	return bbb_tmp117_read_temperature(data, val);
+	switch (attr) {
+	case hwmon_temp_input:
+		return bbb_tmp117_read_temperature(data, val);
+	case hwmon_temp_max:
+		*val = tmp117_raw_to_mc(READ_ONCE(data->thigh));
+		return 0;
+	case hwmon_temp_min:
+		*val = tmp117_raw_to_mc(READ_ONCE(data->tlow));
+		return 0;
+	case hwmon_temp_max_alarm:
+		*val = READ_ONCE(data->max_alarm);
+		return 0;
+	case hwmon_temp_min_alarm:
+		*val = READ_ONCE(data->min_alarm);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+// hwmon write callback
+static int bbb_tmp117_write(struct device *dev, enum hwmon_sensor_types type,
+			    u32 attr, int channel, long val)
+{
+	struct bbb_tmp117_data *data = dev_get_drvdata(dev);
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return bbb_tmp117_set_update_interval(data, val);
+
+	if (type == hwmon_temp && channel == 0 &&
+	    (attr == hwmon_temp_max || attr == hwmon_temp_min))
+		return bbb_tmp117_set_limit(data, attr, val);
+
+	return -EOPNOTSUPP;
 }
 
 // hwmon is_visible callback
 static umode_t bbb_tmp117_is_visible(const void *data, enum hwmon_sensor_types type,
 				     u32 attr, int channel)
 {
-	if (type == hwmon_temp && attr == hwmon_temp_input && channel == 0)
-		return 0444;  // Read-only
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return 0644;
 
-	return 0;
+	if (type != hwmon_temp || channel != 0)
+		return 0;
+
+	switch (attr) {
+	case hwmon_temp_input:
+	case hwmon_temp_max_alarm:
+	case hwmon_temp_min_alarm:
+		return 0444;  // Read-only
+	case hwmon_temp_max:
+	case hwmon_temp_min:
+		// Owned by the thermal zone's trip window when there is one
+		if (((const struct bbb_tmp117_data *)data)->tz)
+			return 0444;
+		return 0644;
+	default:
+		return 0;
+	}
 }
 
 // hwmon operations
 static const struct hwmon_ops bbb_tmp117_hwmon_ops = {
 	.is_visible = bbb_tmp117_is_visible,
 	.read = bbb_tmp117_read,
+	.write = bbb_tmp117_write,
 };
 
-// Channel configuration: one temperature input
+// Chip configuration: conversion rate control
+static const u32 bbb_tmp117_chip_config[] = {
+	HWMON_C_UPDATE_INTERVAL,
+	0
+};
+
+static const struct hwmon_channel_info bbb_tmp117_chip_channel = {
+	.type = hwmon_chip,
+	.config = bbb_tmp117_chip_config,
+};
+
+// Channel configuration: one temperature input with limits and alarms
 static const u32 bbb_tmp117_temp_config[] = {
-	HWMON_T_INPUT,
+	HWMON_T_INPUT | HWMON_T_MAX | HWMON_T_MIN |
+	HWMON_T_MAX_ALARM | HWMON_T_MIN_ALARM,
 	0
 };
 
@@ -82,6 +961,7 @@ static const struct hwmon_channel_info bbb_tmp117_temp_channel = {
 };
 
 static const struct hwmon_channel_info *bbb_tmp117_channel_info[] = {
+	&bbb_tmp117_chip_channel,
 	&bbb_tmp117_temp_channel,
 	NULL
 };
@@ -92,44 +972,424 @@ static const struct hwmon_chip_info bbb_tmp117_chip_info = {
 	.info = bbb_tmp117_channel_info,
 };
 
+// Filtered rate of change in millidegrees Celsius per second
+static ssize_t temp1_slope_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct bbb_tmp117_data *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(data->slope));
+}
+
+static ssize_t temp1_slope_max_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct bbb_tmp117_data *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(data->slope_max));
+}
+
+// Rising slope alarm threshold in mC/s, 0 disables the alarm
+static ssize_t temp1_slope_max_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct bbb_tmp117_data *data = dev_get_drvdata(dev);
+	u32 changed;
+	int val, ret;
+
+	ret = kstrtoint(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (val < 0)
+		return -EINVAL;
+
+	mutex_lock(&data->lock);
+	data->slope_max = val;
+	changed = bbb_tmp117_check_slope(data);
+	mutex_unlock(&data->lock);
+
+	bbb_tmp117_notify_alarms(data, changed);
+	bbb_tmp117_sampler_kick(data);
+	return count;
+}
+
+static ssize_t temp1_slope_alarm_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct bbb_tmp117_data *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(data->slope_alarm));
+}
+
+static DEVICE_ATTR_RO(temp1_slope);
+static DEVICE_ATTR_RW(temp1_slope_max);
+static DEVICE_ATTR_RO(temp1_slope_alarm);
+
+// Non-standard hwmon attributes, next to temp1_input
+static struct attribute *bbb_tmp117_slope_attrs[] = {
+	&dev_attr_temp1_slope.attr,
+	&dev_attr_temp1_slope_max.attr,
+	&dev_attr_temp1_slope_alarm.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(bbb_tmp117_slope);
+
+// Snapshot handed to one reader of the history file
+struct bbb_tmp117_history_snap {
+	size_t len;  // Bytes of valid records
+	struct tmp117_history_entry e[];
+};
+
+static void bbb_tmp117_history_free(void *hist)
+{
+	kvfree(hist);
+}
+
+// Allocate the history ring if enabled by the history_len parameter
+static int bbb_tmp117_history_init(struct bbb_tmp117_data *data)
+{
+	struct device *dev = &data->client->dev;
+	unsigned int len = min(history_len, TMP117_HISTORY_MAX);
+	int ret;
+
+	if (!len)
+		return 0;
+
+	len = roundup_pow_of_two(len);
+	data->hist = kvcalloc(len, sizeof(*data->hist), GFP_KERNEL);
+	if (!data->hist)
+		return -ENOMEM;
+
+	ret = devm_add_action_or_reset(dev, bbb_tmp117_history_free, data->hist);
+	if (ret) {
+		data->hist = NULL;
+		return ret;
+	}
+
+	data->hist_mask = len - 1;
+	return 0;
+}
+
+// Opening the history file snapshots the ring, oldest sample first, so
+// the whole history is read consistently in one call
+static int bbb_tmp117_history_open(struct inode *inode, struct file *file)
+{
+	struct bbb_tmp117_data *data = inode->i_private;
+	struct bbb_tmp117_history_snap *snap;
+	unsigned int size = data->hist_mask + 1;
+	unsigned int i, n, first;
+
+	snap = kvmalloc(struct_size(snap, e, size), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	mutex_lock(&data->lock);
+	n = min_t(u64, data->hist_head, size);
+	first = data->hist_head - n;
+	for (i = 0; i < n; i++)
+		snap->e[i] = data->hist[(first + i) & data->hist_mask];
+	mutex_unlock(&data->lock);
+
+	snap->len = n * sizeof(snap->e[0]);
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t bbb_tmp117_history_read(struct file *file, char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct bbb_tmp117_history_snap *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->e, snap->len);
+}
+
+static int bbb_tmp117_history_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations bbb_tmp117_history_fops = {
+	.owner = THIS_MODULE,
+	.open = bbb_tmp117_history_open,
+	.read = bbb_tmp117_history_read,
+	.llseek = default_llseek,
+	.release = bbb_tmp117_history_release,
+};
+
+static void bbb_tmp117_history_debugfs_remove(void *dir)
+{
+	debugfs_remove_recursive(dir);
+}
+
+// Expose the ring: /sys/kernel/debug/bbb_tmp117-<i2c device>/history
+// holds struct tmp117_history_entry records (see bbb_tmp117.h). The IIO
+// core only creates a per-device directory for drivers with register
+// access, so the driver owns this one. Registered after the ring, so on
+// unbind the file goes away before the ring is freed.
+static int bbb_tmp117_history_debugfs(struct bbb_tmp117_data *data)
+{
+	struct device *dev = &data->client->dev;
+	char name[32];
+
+	if (!data->hist)
+		return 0;
+
+	snprintf(name, sizeof(name), "bbb_tmp117-%s", dev_name(dev));
+	data->debugfs_dir = debugfs_create_dir(name, NULL);
+	debugfs_create_file("history", 0400, data->debugfs_dir, data,
+			    &bbb_tmp117_history_fops);
+
+	return devm_add_action_or_reset(dev, bbb_tmp117_history_debugfs_remove,
+					data->debugfs_dir);
+}
+
+// IIO channels: signed 16-bit result, 7.8125 mC/LSB, plus timestamp
+static const struct iio_chan_spec bbb_tmp117_iio_channels[] = {
+	{
+		.type = IIO_TEMP,
+		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |
+				      BIT(IIO_CHAN_INFO_SCALE),
+		.scan_index = 0,
+		.scan_type = {
+			.sign = 's',
+			.realbits = 16,
+			.storagebits = 16,
+			.endianness = IIO_CPU,
+		},
+	},
+	IIO_CHAN_SOFT_TIMESTAMP(1),
+};
+
+// IIO read_raw callback
+static int bbb_tmp117_iio_read_raw(struct iio_dev *indio_dev,
+				   struct iio_chan_spec const *chan,
+				   int *val, int *val2, long mask)
+{
+	struct bbb_tmp117_data *data = iio_priv(indio_dev);
+	s16 raw;
+	int ret;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_RAW:
+		ret = bbb_tmp117_read_raw_temp(data, &raw);
+		if (ret)
+			return ret;
+		*val = raw;
+		return IIO_VAL_INT;
+
+	case IIO_CHAN_INFO_SCALE:
+		*val = TMP117_SCALE_INT;
+		*val2 = TMP117_SCALE_MICRO;
+		return IIO_VAL_INT_PLUS_MICRO;
+	}
+
+	return -EINVAL;
+}
+
+static const struct iio_info bbb_tmp117_iio_info = {
+	.read_raw = bbb_tmp117_iio_read_raw,
+};
+
+// Buffer scan. On our own data-ready trigger the IRQ thread has just
+// fetched the sample, so push it without touching the bus; any other
+// trigger (e.g. hrtimer) goes through the conversion-cycle cache.
+static irqreturn_t bbb_tmp117_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct bbb_tmp117_data *data = iio_priv(indio_dev);
+	s64 ts = pf->timestamp;
+
+	if (data->trig && indio_dev->trig == data->trig) {
+		mutex_lock(&data->lock);
+		data->scan.temp = data->raw;
+		ts = data->irq_ts;
+		mutex_unlock(&data->lock);
+	} else if (bbb_tmp117_read_raw_temp(data, &data->scan.temp)) {
+		goto done;
+	}
+
+	iio_push_to_buffers_with_timestamp(indio_dev, &data->scan, ts);
+done:
+	iio_trigger_notify_done(indio_dev->trig);
+	return IRQ_HANDLED;
+}
+
+// Data-ready trigger, fired at the conversion rate by the ALERT irq
+static int bbb_tmp117_setup_trigger(struct bbb_tmp117_data *data)
+{
+	struct iio_dev *indio_dev = data->indio_dev;
+	struct device *dev = &data->client->dev;
+	struct iio_trigger *trig;
+	int ret;
+
+	trig = devm_iio_trigger_alloc(dev, "%s-dev%d", indio_dev->name,
+				      iio_device_id(indio_dev));
+	if (!trig)
+		return -ENOMEM;
+
+	iio_trigger_set_drvdata(trig, indio_dev);
+
+	ret = devm_iio_trigger_register(dev, trig);
+	if (ret)
+		return ret;
+
+	data->trig = trig;
+	indio_dev->trig = iio_trigger_get(trig);
+	return 0;
+}
+
 // Probe function (old-style signature for kernel < 6.3)
 static int bbb_tmp117_probe(struct i2c_client *client,
 			    const struct i2c_device_id *id)
 {
 	struct bbb_tmp117_data *data;
+	struct iio_dev *indio_dev;
 	struct device *hwmon_dev;
-	int device_id;
+	unsigned int device_id;
+	unsigned int config, thigh, tlow;
+	int ret;
+
+	// Allocate driver data together with the IIO device
+	indio_dev = devm_iio_device_alloc(&client->dev, sizeof(*data));
+	if (!indio_dev)
+		return -ENOMEM;
+
+	data = iio_priv(indio_dev);
+	data->indio_dev = indio_dev;
+	data->client = client;
+	mutex_init(&data->lock);
+	mutex_init(&data->oneshot_lock);
+	mutex_init(&data->notify_lock);
+	init_waitqueue_head(&data->wait);
+	i2c_set_clientdata(client, data);
+
+	data->regmap = devm_regmap_init_i2c(client, &bbb_tmp117_regmap_config);
+	if (IS_ERR(data->regmap))
+		return dev_err_probe(&client->dev, PTR_ERR(data->regmap),
+				     "Failed to init regmap\n");
+
+	// Periodic sampling for the history ring and the alarms; stays off
+	// until the end of probe, see bbb_tmp117_sampler_start()
+	INIT_DELAYED_WORK(&data->sample_work, bbb_tmp117_sample_work);
 
 	// Verify device ID
-	device_id = i2c_smbus_read_word_data(client, TMP117_REG_DEVICE_ID);
-	if (device_id < 0) {
-		dev_err(&client->dev, "Failed to read device ID: %d\n", device_id);
-		return device_id;
+	ret = regmap_read(data->regmap, TMP117_REG_DEVICE_ID, &device_id);
+	if (ret) {
+		dev_err(&client->dev, "Failed to read device ID: %d\n", ret);
+		return ret;
 	}
-	device_id = swab16(device_id);
 	if (device_id != TMP117_DEVICE_ID) {
 		dev_err(&client->dev, "Unexpected device ID: 0x%04x\n", device_id);
 		return -ENODEV;
 	}
 
-	// Allocate driver data
-	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
-	if (!data)
-		return -ENOMEM;
+	// Prime the register cache; later config reads are free
+	ret = regmap_read(data->regmap, TMP117_REG_CONFIG, &config);
+	if (ret) {
+		dev_err(&client->dev, "Failed to read config: %d\n", ret);
+		return ret;
+	}
 
-	data->client = client;
-	i2c_set_clientdata(client, data);
+	ret = regmap_read(data->regmap, TMP117_REG_THIGH, &thigh);
+	if (!ret)
+		ret = regmap_read(data->regmap, TMP117_REG_TLOW, &tlow);
+	if (ret) {
+		dev_err(&client->dev, "Failed to read limits: %d\n", ret);
+		return ret;
+	}
+	data->thigh = (s16)thigh;
+	data->tlow = (s16)tlow;
+
+	// One-shot mode: park the chip in shutdown, convert only on read
+	data->oneshot = device_property_read_bool(&client->dev, "bbb,one-shot");
+	if (data->oneshot) {
+		ret = regmap_update_bits(data->regmap, TMP117_REG_CONFIG,
+					 TMP117_CONFIG_MOD,
+					 FIELD_PREP(TMP117_CONFIG_MOD,
+						    TMP117_MOD_SHUTDOWN));
+		if (ret)
+			return ret;
+	}
+
+	ret = bbb_tmp117_history_init(data);
+	if (ret)
+		return ret;
+
+	ret = bbb_tmp117_setup_thermal(data);
+	if (ret)
+		return dev_err_probe(&client->dev, ret,
+				     "Failed to register thermal zone\n");
+
+	indio_dev->name = "bbb_tmp117";
+	indio_dev->modes = INDIO_DIRECT_MODE;
+	indio_dev->channels = bbb_tmp117_iio_channels;
+	indio_dev->num_channels = ARRAY_SIZE(bbb_tmp117_iio_channels);
+	indio_dev->info = &bbb_tmp117_iio_info;
+
+	// Optional ALERT interrupt, used in data-ready mode unless the board
+	// dedicates it to limit alerts
+	if (client->irq > 0 &&
+	    device_property_read_bool(&client->dev, "bbb,alert-limits")) {
+		ret = bbb_tmp117_setup_limit_irq(data);
+		if (ret)
+			return dev_err_probe(&client->dev, ret,
+					     "Failed to set up ALERT interrupt\n");
+	} else if (client->irq > 0) {
+		ret = bbb_tmp117_setup_trigger(data);
+		if (ret)
+			return dev_err_probe(&client->dev, ret,
+					     "Failed to register trigger\n");
+
+		ret = bbb_tmp117_setup_irq(data);
+		if (ret)
+			return dev_err_probe(&client->dev, ret,
+					     "Failed to set up ALERT interrupt\n");
+	}
 
 	// Register hwmon device
 	hwmon_dev = devm_hwmon_device_register_with_info(&client->dev,
 							 "bbb_tmp117",
 							 data,
 							 &bbb_tmp117_chip_info,
-							 NULL);
+							 bbb_tmp117_slope_groups);
 	if (IS_ERR(hwmon_dev))
 		return PTR_ERR(hwmon_dev);
+	data->hwmon_dev = hwmon_dev;
+
+	ret = devm_add_action_or_reset(&client->dev, bbb_tmp117_hwmon_detach,
+				       data);
+	if (ret)
+		return ret;
+
+	// Register IIO device for timestamped, buffered streaming
+	ret = devm_iio_triggered_buffer_setup(&client->dev, indio_dev,
+					      iio_pollfunc_store_time,
+					      bbb_tmp117_trigger_handler, NULL);
+	if (ret)
+		return ret;
+
+	ret = devm_iio_device_register(&client->dev, indio_dev);
+	if (ret)
+		return ret;
+
+	ret = bbb_tmp117_history_debugfs(data);
+	if (ret)
+		return ret;
+
+	ret = bbb_tmp117_sampler_start(data);
+	if (ret)
+		return ret;
 
-	dev_info(&client->dev, "BBB TMP117 temperature sensor initialized\n");
+	dev_info(&client->dev, "BBB TMP117 temperature sensor initialized (%s%s)\n",
+		 data->oneshot ? "one-shot, " : "",
+		 data->irq ? "data-ready irq" :
+		 data->limit_irq ? "limit alert irq" : "polled");
+	if (data->tz)
+		dev_info(&client->dev, "thermal zone %s uses THIGH/TLOW as trips\n",
+			 data->tz->type);
 	return 0;
 }
 
@@ -152,6 +1412,9 @@ static struct i2c_driver bbb_tmp117_driver = {
 	.driver = {
 		.name = "bbb_tmp117",
 		.of_match_table = bbb_tmp117_of_match,
+		// Probed from the async domain, in parallel with other devices;
+		// insmod still waits for it unless async_probe=1
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = bbb_tmp117_probe,
 	.id_table = bbb_tmp117_id,
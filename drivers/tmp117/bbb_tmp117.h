@@ -0,0 +1,95 @@
+#ifndef BBB_TMP117_H
+#define BBB_TMP117_H
+
+#include <linux/bits.h>
+#include <linux/bitfield.h>
+#include <linux/math.h>
+#include <linux/minmax.h>
+#include <linux/types.h>
+
+/* TMP117 register map - shared by bbb_tmp117 and bbb_tmp117_array */
+
+// Register definitions
+#define TMP117_REG_TEMP        0x00  // Temperature result register
+#define TMP117_REG_CONFIG      0x01  // Configuration register
+#define TMP117_REG_THIGH       0x02  // High limit register
+#define TMP117_REG_TLOW        0x03  // Low limit register
+#define TMP117_REG_TEMP_OFFSET 0x07  // Temperature offset register
+#define TMP117_REG_DEVICE_ID   0x0F  // Device ID register
+
+// Configuration register fields
+#define TMP117_CONFIG_HIGH_ALERT  BIT(15)     // Result above THIGH (clear on read)
+#define TMP117_CONFIG_LOW_ALERT   BIT(14)     // Result below TLOW (clear on read)
+#define TMP117_CONFIG_DATA_READY  BIT(13)     // Conversion completed
+#define TMP117_CONFIG_MOD      GENMASK(11, 10)  // Conversion mode
+#define TMP117_CONFIG_CONV     GENMASK(9, 7)  // Conversion cycle time
+#define TMP117_CONFIG_AVG      GENMASK(6, 5)  // Conversion averaging
+#define TMP117_CONFIG_TNA      BIT(4)         // Therm mode (0 = alert mode)
+#define TMP117_CONFIG_POL      BIT(3)         // ALERT pin active high
+#define TMP117_CONFIG_DR_ALERT BIT(2)         // ALERT pin reflects data-ready
+
+// Conversion modes (MOD field)
+#define TMP117_MOD_CONTINUOUS  0
+#define TMP117_MOD_SHUTDOWN    1
+#define TMP117_MOD_ONE_SHOT    3
+
+// Device ID
+#define TMP117_DEVICE_ID       0x0117
+
+// Resolution: 7.8125 mC/LSB = 78125 uC / 10000
+#define TMP117_RESOLUTION_NUM  78125
+#define TMP117_RESOLUTION_DEN  10000
+
+// Same resolution as IIO scale (mC/LSB): 7 + 812500 / 10^6
+#define TMP117_SCALE_INT       7
+#define TMP117_SCALE_MICRO     812500
+
+// One record of the bbb_tmp117 debugfs history blob (native endian)
+struct tmp117_history_entry {
+	s64 ts_ns;  // CLOCK_MONOTONIC time the result was read
+	s32 mc;     // Temperature in millidegrees Celsius
+	u32 seq;    // Running sample number, shows overwritten samples
+};
+
+// Convert a raw result to millidegrees Celsius: raw * 7.8125 mC
+// = raw * 78125 / 10000 (using integer math)
+static inline long tmp117_raw_to_mc(s16 raw)
+{
+	return ((long)raw * TMP117_RESOLUTION_NUM) / TMP117_RESOLUTION_DEN;
+}
+
+// Convert millidegrees Celsius to the nearest raw value, saturating at
+// the register range. 7.8125 mC/LSB = 125/16, so this fits in 32 bits.
+static inline s16 tmp117_mc_to_raw(long mc)
+{
+	mc = clamp_val(mc, -256000L, 255992L);
+	return DIV_ROUND_CLOSEST(mc * 16, 125);
+}
+
+// Conversion cycle time in microseconds for a CONFIG value.
+// Averaging stretches short cycles (datasheet table 7-7).
+static inline u32 tmp117_cycle_time_us(u16 config)
+{
+	static const u32 cycle_us[8][4] = {
+		{    15500,   125000,   500000,  1000000 },
+		{   125000,   125000,   500000,  1000000 },
+		{   250000,   250000,   500000,  1000000 },
+		{   500000,   500000,   500000,  1000000 },
+		{  1000000,  1000000,  1000000,  1000000 },
+		{  4000000,  4000000,  4000000,  4000000 },
+		{  8000000,  8000000,  8000000,  8000000 },
+		{ 16000000, 16000000, 16000000, 16000000 },
+	};
+
+	return cycle_us[FIELD_GET(TMP117_CONFIG_CONV, config)]
+		       [FIELD_GET(TMP117_CONFIG_AVG, config)];
+}
+
+// Active conversion time for a one-shot with the configured averaging:
+// the CONV=0 row, where no standby time is added.
+static inline u32 tmp117_conversion_time_us(u16 config)
+{
+	return tmp117_cycle_time_us(config & ~TMP117_CONFIG_CONV);
+}
+
+#endif /* BBB_TMP117_H */
@@ -0,0 +1,461 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BBB TMP117 Array Driver
+ *
+ * Aggregates up to four TMP117 sensors (0x48-0x4B) on one I2C bus into a
+ * single hwmon and IIO device. One snapshot reads every sensor with a
+ * single i2c_transfer() (pointer write + repeated-start read per sensor)
+ * and stamps all channels with one shared timestamp.
+ *
+ * Binds to: compatible = "bbb,tmp117-array"
+ *   reg = <0x48>;
+ *   bbb,sensor-addresses = <0x48 0x49 0x4a 0x4b>;
+ *
+ * All sensors are expected to run with the same CONV/AVG setting; the
+ * conversion period is taken from the first one.
+ *
+ * Author: Chun
+ */
+
+#include <linux/module.h>
+#include <linux/i2c.h>
+#include <linux/hwmon.h>
+#include <linux/property.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#include <asm/unaligned.h>
+#include "bbb_tmp117.h"
+
+#define TMP117_ARRAY_MAX       4  // TMP117 has four possible addresses
+
+// Driver private data structure (lives in the IIO device's private area)
+struct bbb_tmp117_array {
+	struct i2c_client *client;
+	struct iio_dev *indio_dev;
+	struct mutex lock;     // Serializes snapshots, protects results
+	unsigned int num;      // Number of sensors
+	u16 addr[TMP117_ARRAY_MAX];
+	char label[TMP117_ARRAY_MAX][16];
+	struct i2c_msg msgs[2 * TMP117_ARRAY_MAX];
+	u32 cycle_us;          // Conversion period of the sensors
+	s16 raw[TMP117_ARRAY_MAX];
+	s64 timestamp;         // Shared IIO timestamp of the snapshot
+	ktime_t last_update;
+	bool valid;
+
+	// Buffer scan: all sensors plus naturally aligned timestamp
+	struct {
+		s16 temp[TMP117_ARRAY_MAX];
+		s64 ts __aligned(8);
+	} scan;
+
+	// Transfer buffers, DMA-safe for the adapter. tx and rx each get
+	// their own cacheline, so invalidating rx cannot clobber reg; the rx
+	// slots share one, but the CPU never writes them during a transfer.
+	u8 reg __aligned(IIO_DMA_MINALIGN);
+	u8 rx[TMP117_ARRAY_MAX][2] __aligned(IIO_DMA_MINALIGN);
+};
+
+// Read the same register from every sensor in one combined transaction
+static int bbb_tmp117_array_xfer(struct bbb_tmp117_array *arr, u8 reg)
+{
+	int ret;
+
+	arr->reg = reg;
+
+	ret = i2c_transfer(arr->client->adapter, arr->msgs, 2 * arr->num);
+	if (ret < 0)
+		return ret;
+	if (ret != 2 * arr->num)
+		return -EIO;
+
+	return 0;
+}
+
+// Refresh all results if the snapshot is older than one conversion cycle.
+// Must be called with arr->lock held.
+static int bbb_tmp117_array_update(struct bbb_tmp117_array *arr)
+{
+	ktime_t now = ktime_get();
+	s64 ts;
+	unsigned int i;
+	int ret;
+
+	if (arr->valid && ktime_us_delta(now, arr->last_update) < arr->cycle_us)
+		return 0;
+
+	ts = iio_get_time_ns(arr->indio_dev);
+
+	ret = bbb_tmp117_array_xfer(arr, TMP117_REG_TEMP);
+	if (ret) {
+		dev_err_ratelimited(&arr->client->dev,
+				    "Failed to read temperatures: %d\n", ret);
+		return ret;
+	}
+
+	for (i = 0; i < arr->num; i++)
+		arr->raw[i] = (s16)get_unaligned_be16(arr->rx[i]);
+
+	arr->timestamp = ts;
+	arr->last_update = now;
+	arr->valid = true;
+	return 0;
+}
+
+static int bbb_tmp117_array_read_raw_temp(struct bbb_tmp117_array *arr,
+					  int channel, s16 *val)
+{
+	int ret;
+
+	mutex_lock(&arr->lock);
+	ret = bbb_tmp117_array_update(arr);
+	if (!ret)
+		*val = arr->raw[channel];
+	mutex_unlock(&arr->lock);
+
+	return ret;
+}
+
+// hwmon read callback
+static int bbb_tmp117_array_read(struct device *dev,
+				 enum hwmon_sensor_types type,
+				 u32 attr, int channel, long *val)
+{
+	struct bbb_tmp117_array *arr = dev_get_drvdata(dev);
+	s16 raw;
+	int ret;
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval) {
+		*val = DIV_ROUND_CLOSEST(arr->cycle_us, 1000);
+		return 0;
+	}
+
+	if (type != hwmon_temp || attr != hwmon_temp_input)
+		return -EOPNOTSUPP;
+
+	ret = bbb_tmp117_array_read_raw_temp(arr, channel, &raw);
+	if (ret)
+		return ret;
+
+	*val = tmp117_raw_to_mc(raw);
+	return 0;
+}
+
+// hwmon read_string callback: label each channel with its address
+static int bbb_tmp117_array_read_string(struct device *dev,
+					enum hwmon_sensor_types type,
+					u32 attr, int channel, const char **str)
+{
+	struct bbb_tmp117_array *arr = dev_get_drvdata(dev);
+
+	if (type != hwmon_temp || attr != hwmon_temp_label)
+		return -EOPNOTSUPP;
+
+	*str = arr->label[channel];
+	return 0;
+}
+
+// hwmon is_visible callback: hide channels without a sensor
+static umode_t bbb_tmp117_array_is_visible(const void *drvdata,
+					   enum hwmon_sensor_types type,
+					   u32 attr, int channel)
+{
+	const struct bbb_tmp117_array *arr = drvdata;
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return 0444;
+
+	if (type == hwmon_temp && channel < arr->num &&
+	    (attr == hwmon_temp_input || attr == hwmon_temp_label))
+		return 0444;
+
+	return 0;
+}
+
+// hwmon operations
+static const struct hwmon_ops bbb_tmp117_array_hwmon_ops = {
+	.is_visible = bbb_tmp117_array_is_visible,
+	.read = bbb_tmp117_array_read,
+	.read_string = bbb_tmp117_array_read_string,
+};
+
+static const u32 bbb_tmp117_array_chip_config[] = {
+	HWMON_C_UPDATE_INTERVAL,
+	0
+};
+
+static const struct hwmon_channel_info bbb_tmp117_array_chip_channel = {
+	.type = hwmon_chip,
+	.config = bbb_tmp117_array_chip_config,
+};
+
+// Channel configuration: one temperature input per possible sensor
+static const u32 bbb_tmp117_array_temp_config[] = {
+	HWMON_T_INPUT | HWMON_T_LABEL,
+	HWMON_T_INPUT | HWMON_T_LABEL,
+	HWMON_T_INPUT | HWMON_T_LABEL,
+	HWMON_T_INPUT | HWMON_T_LABEL,
+	0
+};
+
+static const struct hwmon_channel_info bbb_tmp117_array_temp_channel = {
+	.type = hwmon_temp,
+	.config = bbb_tmp117_array_temp_config,
+};
+
+static const struct hwmon_channel_info *bbb_tmp117_array_channel_info[] = {
+	&bbb_tmp117_array_chip_channel,
+	&bbb_tmp117_array_temp_channel,
+	NULL
+};
+
+// hwmon chip info
+static const struct hwmon_chip_info bbb_tmp117_array_chip_info = {
+	.ops = &bbb_tmp117_array_hwmon_ops,
+	.info = bbb_tmp117_array_channel_info,
+};
+
+// IIO read_raw callback
+static int bbb_tmp117_array_iio_read_raw(struct iio_dev *indio_dev,
+					 struct iio_chan_spec const *chan,
+					 int *val, int *val2, long mask)
+{
+	struct bbb_tmp117_array *arr = iio_priv(indio_dev);
+	s16 raw;
+	int ret;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_RAW:
+		ret = bbb_tmp117_array_read_raw_temp(arr, chan->channel, &raw);
+		if (ret)
+			return ret;
+		*val = raw;
+		return IIO_VAL_INT;
+
+	case IIO_CHAN_INFO_SCALE:
+		*val = TMP117_SCALE_INT;
+		*val2 = TMP117_SCALE_MICRO;
+		return IIO_VAL_INT_PLUS_MICRO;
+	}
+
+	return -EINVAL;
+}
+
+static const struct iio_info bbb_tmp117_array_iio_info = {
+	.read_raw = bbb_tmp117_array_iio_read_raw,
+};
+
+// Buffer scan: one snapshot, one shared timestamp for every channel
+static irqreturn_t bbb_tmp117_array_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct bbb_tmp117_array *arr = iio_priv(indio_dev);
+	int bit, i = 0;
+
+	mutex_lock(&arr->lock);
+	if (bbb_tmp117_array_update(arr))
+		goto unlock;
+
+	for_each_set_bit(bit, indio_dev->active_scan_mask,
+			 indio_dev->masklength)
+		arr->scan.temp[i++] = arr->raw[bit];
+
+	iio_push_to_buffers_with_timestamp(indio_dev, &arr->scan,
+					   arr->timestamp);
+unlock:
+	mutex_unlock(&arr->lock);
+	iio_trigger_notify_done(indio_dev->trig);
+	return IRQ_HANDLED;
+}
+
+// Build one IIO channel per sensor plus the timestamp
+static int bbb_tmp117_array_init_iio(struct bbb_tmp117_array *arr)
+{
+	struct device *dev = &arr->client->dev;
+	struct iio_dev *indio_dev = arr->indio_dev;
+	struct iio_chan_spec *chans;
+	unsigned int i;
+
+	chans = devm_kcalloc(dev, arr->num + 1, sizeof(*chans), GFP_KERNEL);
+	if (!chans)
+		return -ENOMEM;
+
+	for (i = 0; i < arr->num; i++) {
+		chans[i].type = IIO_TEMP;
+		chans[i].indexed = 1;
+		chans[i].channel = i;
+		chans[i].info_mask_separate = BIT(IIO_CHAN_INFO_RAW);
+		chans[i].info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE);
+		chans[i].scan_index = i;
+		chans[i].scan_type.sign = 's';
+		chans[i].scan_type.realbits = 16;
+		chans[i].scan_type.storagebits = 16;
+		chans[i].scan_type.endianness = IIO_CPU;
+	}
+
+	chans[i].type = IIO_TIMESTAMP;
+	chans[i].channel = -1;
+	chans[i].scan_index = i;
+	chans[i].scan_type.sign = 's';
+	chans[i].scan_type.realbits = 64;
+	chans[i].scan_type.storagebits = 64;
+
+	indio_dev->name = "bbb_tmp117_array";
+	indio_dev->modes = INDIO_DIRECT_MODE;
+	indio_dev->channels = chans;
+	indio_dev->num_channels = arr->num + 1;
+	indio_dev->info = &bbb_tmp117_array_iio_info;
+	return 0;
+}
+
+// Probe function (old-style signature for kernel < 6.3)
+static int bbb_tmp117_array_probe(struct i2c_client *client,
+				  const struct i2c_device_id *id)
+{
+	struct device *dev = &client->dev;
+	struct bbb_tmp117_array *arr;
+	struct iio_dev *indio_dev;
+	struct device *hwmon_dev;
+	struct i2c_client *dummy;
+	u32 addrs[TMP117_ARRAY_MAX];
+	unsigned int i;
+	int num, ret;
+
+	if (!i2c_check_functionality(client->adapter, I2C_FUNC_I2C))
+		return dev_err_probe(dev, -EOPNOTSUPP,
+				     "Adapter cannot do combined transfers\n");
+
+	// Allocate driver data together with the IIO device
+	indio_dev = devm_iio_device_alloc(dev, sizeof(*arr));
+	if (!indio_dev)
+		return -ENOMEM;
+
+	arr = iio_priv(indio_dev);
+	arr->indio_dev = indio_dev;
+	arr->client = client;
+	mutex_init(&arr->lock);
+	i2c_set_clientdata(client, arr);
+
+	num = device_property_count_u32(dev, "bbb,sensor-addresses");
+	if (num <= 0) {
+		addrs[0] = client->addr;
+		num = 1;
+	} else if (num > TMP117_ARRAY_MAX) {
+		return dev_err_probe(dev, -EINVAL, "Too many sensors: %d\n", num);
+	} else {
+		ret = device_property_read_u32_array(dev, "bbb,sensor-addresses",
+						     addrs, num);
+		if (ret)
+			return ret;
+	}
+	arr->num = num;
+
+	for (i = 0; i < arr->num; i++) {
+		arr->addr[i] = addrs[i];
+		snprintf(arr->label[i], sizeof(arr->label[i]), "tmp117@0x%02x",
+			 arr->addr[i]);
+
+		// Reserve the other addresses so no other driver binds there
+		if (arr->addr[i] != client->addr) {
+			dummy = devm_i2c_new_dummy_device(dev, client->adapter,
+							  arr->addr[i]);
+			if (IS_ERR(dummy))
+				return dev_err_probe(dev, PTR_ERR(dummy),
+						     "Address 0x%02x busy\n",
+						     arr->addr[i]);
+		}
+
+		// Pointer write, then repeated-start 2-byte read
+		arr->msgs[2 * i] = (struct i2c_msg) {
+			.addr = arr->addr[i],
+			.len = 1,
+			.buf = &arr->reg,
+		};
+		arr->msgs[2 * i + 1] = (struct i2c_msg) {
+			.addr = arr->addr[i],
+			.flags = I2C_M_RD,
+			.len = 2,
+			.buf = arr->rx[i],
+		};
+	}
+
+	// Verify every device ID in one transaction
+	ret = bbb_tmp117_array_xfer(arr, TMP117_REG_DEVICE_ID);
+	if (ret)
+		return dev_err_probe(dev, ret, "Failed to read device IDs\n");
+
+	for (i = 0; i < arr->num; i++) {
+		if (get_unaligned_be16(arr->rx[i]) != TMP117_DEVICE_ID)
+			return dev_err_probe(dev, -ENODEV,
+					     "Unexpected device ID 0x%04x at 0x%02x\n",
+					     get_unaligned_be16(arr->rx[i]),
+					     arr->addr[i]);
+	}
+
+	ret = bbb_tmp117_array_xfer(arr, TMP117_REG_CONFIG);
+	if (ret)
+		return dev_err_probe(dev, ret, "Failed to read config\n");
+	arr->cycle_us = tmp117_cycle_time_us(get_unaligned_be16(arr->rx[0]));
+
+	// Register hwmon device
+	hwmon_dev = devm_hwmon_device_register_with_info(dev, "bbb_tmp117_array",
+							 arr,
+							 &bbb_tmp117_array_chip_info,
+							 NULL);
+	if (IS_ERR(hwmon_dev))
+		return PTR_ERR(hwmon_dev);
+
+	// Register IIO device for shared-timestamp buffered snapshots
+	ret = bbb_tmp117_array_init_iio(arr);
+	if (ret)
+		return ret;
+
+	ret = devm_iio_triggered_buffer_setup(dev, indio_dev, NULL,
+					      bbb_tmp117_array_trigger_handler,
+					      NULL);
+	if (ret)
+		return ret;
+
+	ret = devm_iio_device_register(dev, indio_dev);
+	if (ret)
+		return ret;
+
+	dev_info(dev, "BBB TMP117 array initialized (%u sensors)\n", arr->num);
+	return 0;
+}
+
+// I2C device ID table
+static const struct i2c_device_id bbb_tmp117_array_id[] = {
+	{ "bbb_tmp117_array", 0 },
+	{ }
+};
+MODULE_DEVICE_TABLE(i2c, bbb_tmp117_array_id);
+
+// Device tree match table
+static const struct of_device_id bbb_tmp117_array_of_match[] = {
+	{ .compatible = "bbb,tmp117-array" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, bbb_tmp117_array_of_match);
+
+// I2C driver structure
+static struct i2c_driver bbb_tmp117_array_driver = {
+	.driver = {
+		.name = "bbb_tmp117_array",
+		.of_match_table = bbb_tmp117_array_of_match,
+		// Probe may run concurrently with other drivers' probes
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	},
+	.probe = bbb_tmp117_array_probe,
+	.id_table = bbb_tmp117_array_id,
+};
+module_i2c_driver(bbb_tmp117_array_driver);
+
+MODULE_AUTHOR("Chun");
+MODULE_DESCRIPTION("BBB Flagship TMP117 Multi-Sensor Array Driver");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,631 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Software TMP117 behind a stub I2C adapter
+ *
+ * Registers a platform device providing an I2C adapter with up to four
+ * TMP117 register models at 0x48-0x4B. Each model converts on an hrtimer
+ * at the configured CONV/AVG rate (or once per one-shot request), follows
+ * a scripted temperature profile, sets the Data_Ready and HIGH/LOW_Alert
+ * flags and drives an ALERT line, so the unmodified bbb_tmp117 and
+ * bbb_tmp117_array drivers bind to it on any Linux host.
+ *
+ * The ALERT line of the first sensor is an interrupt from a private irq
+ * domain, handed to the instantiated client as client->irq.
+ *
+ * Usage:
+ *   insmod bbb_tmp117_sim.ko profile=sine base_mc=40000 amplitude_mc=10000
+ *   insmod bbb_tmp117.ko
+ *
+ *   insmod bbb_tmp117_sim.ko instantiate=bbb_tmp117_array nr_sensors=4
+ *   insmod bbb_tmp117_array.ko
+ *
+ * Profile and timing parameters can be changed at runtime under
+ * /sys/module/bbb_tmp117_sim/parameters/; xfers and msgs count the I2C
+ * traffic and are reset by writing 0.
+ *
+ * Author: Chun
+ */
+
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/i2c.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
+#include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <linux/property.h>
+#include <linux/fixp-arith.h>
+#include <linux/delay.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <asm/unaligned.h>
+#include "bbb_tmp117.h"
+
+#define SIM_NAME		"bbb_tmp117_sim"
+#define SIM_MAX_SENSORS		4
+#define SIM_BASE_ADDR		0x48
+#define SIM_SCRIPT_MAX		16
+
+// Sensors read 0.25 C apart so they are distinguishable
+#define SIM_SENSOR_STEP_MC	250
+
+// Power-on register values (datasheet table 7-6)
+#define SIM_CONFIG_DEFAULT	0x0220  // Continuous, 1 s cycle, 8 averages
+#define SIM_THIGH_DEFAULT	0x6000  // 192 C
+#define SIM_TLOW_DEFAULT	0x8000  // -256 C
+
+// Writable CONFIG bits; the flags and soft reset are not stored
+#define SIM_CONFIG_RW		(TMP117_CONFIG_MOD | TMP117_CONFIG_CONV | \
+				 TMP117_CONFIG_AVG | TMP117_CONFIG_TNA | \
+				 TMP117_CONFIG_POL | TMP117_CONFIG_DR_ALERT)
+
+enum tmp117_sim_profile {
+	SIM_PROFILE_CONSTANT,
+	SIM_PROFILE_RAMP,
+	SIM_PROFILE_SINE,
+	SIM_PROFILE_STEP,
+	SIM_PROFILE_SCRIPT,
+};
+
+static const char * const tmp117_sim_profiles[] = {
+	[SIM_PROFILE_CONSTANT] = "constant",
+	[SIM_PROFILE_RAMP] = "ramp",
+	[SIM_PROFILE_SINE] = "sine",
+	[SIM_PROFILE_STEP] = "step",
+	[SIM_PROFILE_SCRIPT] = "script",
+};
+
+static int profile = SIM_PROFILE_CONSTANT;
+
+static int tmp117_sim_profile_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = sysfs_match_string(tmp117_sim_profiles, val);
+
+	if (ret < 0)
+		return ret;
+
+	WRITE_ONCE(profile, ret);
+	return 0;
+}
+
+static int tmp117_sim_profile_get(char *buf, const struct kernel_param *kp)
+{
+	return sysfs_emit(buf, "%s\n", tmp117_sim_profiles[READ_ONCE(profile)]);
+}
+
+static const struct kernel_param_ops tmp117_sim_profile_ops = {
+	.set = tmp117_sim_profile_set,
+	.get = tmp117_sim_profile_get,
+};
+module_param_cb(profile, &tmp117_sim_profile_ops, NULL, 0644);
+MODULE_PARM_DESC(profile, "Temperature profile: constant, ramp, sine, step or script");
+
+static int base_mc = 25000;
+module_param(base_mc, int, 0644);
+MODULE_PARM_DESC(base_mc, "Constant value, or start/centre of the profile (mC)");
+
+static int amplitude_mc = 5000;
+module_param(amplitude_mc, int, 0644);
+MODULE_PARM_DESC(amplitude_mc, "Sine peak or step height (mC)");
+
+static int rate_mc_per_s = 1000;
+module_param(rate_mc_per_s, int, 0644);
+MODULE_PARM_DESC(rate_mc_per_s, "Ramp slope (mC/s), restarting every period");
+
+static unsigned int period_ms = 10000;
+module_param(period_ms, uint, 0644);
+MODULE_PARM_DESC(period_ms, "Ramp/sine/step period, or time per script point (ms)");
+
+static int script[SIM_SCRIPT_MAX];
+static unsigned int script_len;
+module_param_array(script, int, &script_len, 0644);
+MODULE_PARM_DESC(script, "Script profile: temperatures (mC) held for period_ms each, looping");
+
+static unsigned int latency_us;
+module_param(latency_us, uint, 0644);
+MODULE_PARM_DESC(latency_us, "Extra latency added to every I2C transfer");
+
+static unsigned int nr_sensors = 1;
+module_param(nr_sensors, uint, 0444);
+MODULE_PARM_DESC(nr_sensors, "Number of sensors at 0x48 upwards (1-4)");
+
+static char *instantiate = "bbb_tmp117";
+module_param(instantiate, charp, 0444);
+MODULE_PARM_DESC(instantiate, "Client to create: bbb_tmp117, bbb_tmp117_array or none");
+
+static bool alert_limits;
+module_param(alert_limits, bool, 0444);
+MODULE_PARM_DESC(alert_limits, "Pass bbb,alert-limits to bbb_tmp117");
+
+static bool one_shot;
+module_param(one_shot, bool, 0444);
+MODULE_PARM_DESC(one_shot, "Pass bbb,one-shot to bbb_tmp117");
+
+static bool no_irq;
+module_param(no_irq, bool, 0444);
+MODULE_PARM_DESC(no_irq, "Do not wire ALERT to bbb_tmp117 (polled mode)");
+
+// Traffic counters, updated under the adapter's bus lock
+static unsigned long xfers;
+module_param(xfers, ulong, 0644);
+MODULE_PARM_DESC(xfers, "I2C transfers handled (write 0 to reset)");
+
+static unsigned long msgs;
+module_param(msgs, ulong, 0644);
+MODULE_PARM_DESC(msgs, "I2C messages handled (write 0 to reset)");
+
+struct tmp117_sim;
+
+// Register model of one sensor (under sim->lock)
+struct tmp117_sim_chip {
+	struct tmp117_sim *sim;
+	struct hrtimer timer;  // End of the current conversion
+	unsigned int index;
+	u16 addr;
+	u8 ptr;                // Register pointer
+	u16 config;            // Writable CONFIG bits
+	u16 flags;             // HIGH/LOW_Alert and Data_Ready
+	s16 temp, thigh, tlow, offset;
+	bool alert;            // ALERT pin asserted
+};
+
+struct tmp117_sim {
+	struct i2c_adapter adap;
+	spinlock_t lock;       // Chip state, shared with the hrtimers
+	ktime_t t0;            // Profile time origin
+	struct irq_domain *domain;
+	unsigned int irq;      // ALERT of sensor 0
+	unsigned int nr;
+	struct tmp117_sim_chip chips[SIM_MAX_SENSORS];
+
+	// Firmware properties for the instantiated client
+	u32 addrs[SIM_MAX_SENSORS];
+	struct property_entry props[3];
+	struct software_node swnode;
+};
+
+// Profile temperature (mC) at the current time
+static long tmp117_sim_profile(struct tmp117_sim *sim)
+{
+	u64 t_ms = ktime_ms_delta(ktime_get(), sim->t0);
+	unsigned int p = max(READ_ONCE(period_ms), 1U);
+	unsigned int n = READ_ONCE(script_len);
+	long base = READ_ONCE(base_mc);
+	long amp = READ_ONCE(amplitude_mc);
+	u32 phase;
+
+	div_u64_rem(t_ms, p, &phase);
+
+	switch (READ_ONCE(profile)) {
+	case SIM_PROFILE_RAMP:
+		return base + div_s64((s64)READ_ONCE(rate_mc_per_s) * phase, 1000);
+	case SIM_PROFILE_SINE:
+		return base + (long)(((s64)amp *
+			fixp_sin32(div_u64((u64)phase * 360, p))) >> 31);
+	case SIM_PROFILE_STEP:
+		return phase < p / 2 ? base : base + amp;
+	case SIM_PROFILE_SCRIPT:
+		if (!n)
+			return base;
+		div_u64_rem(div_u64(t_ms, p), min_t(unsigned int, n, SIM_SCRIPT_MAX),
+			    &phase);
+		return READ_ONCE(script[phase]);
+	default:
+		return base;
+	}
+}
+
+// Latch a new result and update the limit flags. Alert mode sets
+// HIGH/LOW_Alert until read; therm mode keeps HIGH_Alert between THIGH
+// and TLOW (hysteresis).
+static void tmp117_sim_result(struct tmp117_sim_chip *chip)
+{
+	long mc = tmp117_sim_profile(chip->sim) +
+		  chip->index * SIM_SENSOR_STEP_MC;
+	int raw = tmp117_mc_to_raw(mc) + chip->offset;
+
+	chip->temp = clamp(raw, (int)S16_MIN, (int)S16_MAX);
+	chip->flags |= TMP117_CONFIG_DATA_READY;
+
+	if (chip->config & TMP117_CONFIG_TNA) {
+		if (chip->temp > chip->thigh)
+			chip->flags |= TMP117_CONFIG_HIGH_ALERT;
+		else if (chip->temp < chip->tlow)
+			chip->flags &= ~TMP117_CONFIG_HIGH_ALERT;
+	} else {
+		if (chip->temp > chip->thigh)
+			chip->flags |= TMP117_CONFIG_HIGH_ALERT;
+		if (chip->temp < chip->tlow)
+			chip->flags |= TMP117_CONFIG_LOW_ALERT;
+	}
+}
+
+// Re-evaluate the ALERT pin. Returns true on an assertion edge of a pin
+// that is wired to the interrupt.
+static bool tmp117_sim_update_alert(struct tmp117_sim_chip *chip)
+{
+	bool active, edge;
+
+	if (chip->config & TMP117_CONFIG_DR_ALERT)
+		active = chip->flags & TMP117_CONFIG_DATA_READY;
+	else
+		active = chip->flags & (TMP117_CONFIG_HIGH_ALERT |
+					TMP117_CONFIG_LOW_ALERT);
+
+	edge = active && !chip->alert;
+	chip->alert = active;
+
+	return edge && chip->index == 0 && chip->sim->irq;
+}
+
+// Restart conversions as the chip does after a CONFIG write.
+// Must hold sim->lock.
+static void tmp117_sim_arm(struct tmp117_sim_chip *chip)
+{
+	u32 us;
+
+	switch (FIELD_GET(TMP117_CONFIG_MOD, chip->config)) {
+	case TMP117_MOD_SHUTDOWN:
+		// A running callback sees the mode and stops by itself
+		hrtimer_try_to_cancel(&chip->timer);
+		return;
+	case TMP117_MOD_ONE_SHOT:
+		us = tmp117_conversion_time_us(chip->config);
+		break;
+	default:
+		us = tmp117_cycle_time_us(chip->config);
+		break;
+	}
+
+	hrtimer_start(&chip->timer, us_to_ktime(us), HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart tmp117_sim_convert(struct hrtimer *timer)
+{
+	struct tmp117_sim_chip *chip = container_of(timer, struct tmp117_sim_chip,
+						    timer);
+	enum hrtimer_restart restart = HRTIMER_NORESTART;
+	struct tmp117_sim *sim = chip->sim;
+	unsigned long irqflags;
+	bool fire = false;
+
+	spin_lock_irqsave(&sim->lock, irqflags);
+
+	switch (FIELD_GET(TMP117_CONFIG_MOD, chip->config)) {
+	case TMP117_MOD_SHUTDOWN:
+		goto unlock;
+	case TMP117_MOD_ONE_SHOT:
+		// Back to shutdown once the conversion is done
+		tmp117_sim_result(chip);
+		chip->config &= ~TMP117_CONFIG_MOD;
+		chip->config |= FIELD_PREP(TMP117_CONFIG_MOD, TMP117_MOD_SHUTDOWN);
+		break;
+	default:
+		tmp117_sim_result(chip);
+		hrtimer_forward_now(timer,
+				    us_to_ktime(tmp117_cycle_time_us(chip->config)));
+		restart = HRTIMER_RESTART;
+		break;
+	}
+
+	fire = tmp117_sim_update_alert(chip);
+unlock:
+	spin_unlock_irqrestore(&sim->lock, irqflags);
+
+	if (fire)
+		generic_handle_irq_safe(sim->irq);
+
+	return restart;
+}
+
+// Register read with its side effects: reading the result or CONFIG
+// clears Data_Ready; reading CONFIG in alert mode clears the limit flags
+static u16 tmp117_sim_read_reg(struct tmp117_sim_chip *chip, u8 reg)
+{
+	u16 val;
+
+	switch (reg) {
+	case TMP117_REG_TEMP:
+		val = chip->temp;
+		chip->flags &= ~TMP117_CONFIG_DATA_READY;
+		break;
+	case TMP117_REG_CONFIG:
+		val = chip->config | chip->flags;
+		chip->flags &= ~TMP117_CONFIG_DATA_READY;
+		if (!(chip->config & TMP117_CONFIG_TNA))
+			chip->flags &= ~(TMP117_CONFIG_HIGH_ALERT |
+					 TMP117_CONFIG_LOW_ALERT);
+		break;
+	case TMP117_REG_THIGH:
+		val = chip->thigh;
+		break;
+	case TMP117_REG_TLOW:
+		val = chip->tlow;
+		break;
+	case TMP117_REG_TEMP_OFFSET:
+		val = chip->offset;
+		break;
+	case TMP117_REG_DEVICE_ID:
+		val = TMP117_DEVICE_ID;
+		break;
+	default:
+		val = 0;
+		break;
+	}
+
+	return val;
+}
+
+static void tmp117_sim_write_reg(struct tmp117_sim_chip *chip, u8 reg, u16 val)
+{
+	switch (reg) {
+	case TMP117_REG_CONFIG:
+		chip->config = val & SIM_CONFIG_RW;
+		tmp117_sim_arm(chip);
+		break;
+	case TMP117_REG_THIGH:
+		chip->thigh = val;
+		break;
+	case TMP117_REG_TLOW:
+		chip->tlow = val;
+		break;
+	case TMP117_REG_TEMP_OFFSET:
+		chip->offset = val;
+		break;
+	default:
+		break;  // Read-only or unimplemented: ignored, as on the chip
+	}
+}
+
+static struct tmp117_sim_chip *tmp117_sim_find(struct tmp117_sim *sim, u16 addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < sim->nr; i++)
+		if (sim->chips[i].addr == addr)
+			return &sim->chips[i];
+
+	return NULL;
+}
+
+// Each write message sets the pointer and, with two more bytes, writes
+// the register; each read message returns the pointed-to register
+// big-endian. An unknown address NAKs the whole transfer.
+static int tmp117_sim_xfer(struct i2c_adapter *adap, struct i2c_msg *msg,
+			   int num)
+{
+	struct tmp117_sim *sim = i2c_get_adapdata(adap);
+	struct tmp117_sim_chip *chip;
+	unsigned long irqflags;
+	bool fire = false;
+	int i, j, ret = num;
+	u16 val;
+
+	xfers++;
+	msgs += num;
+
+	spin_lock_irqsave(&sim->lock, irqflags);
+
+	for (i = 0; i < num; i++, msg++) {
+		chip = tmp117_sim_find(sim, msg->addr);
+		if (!chip) {
+			ret = -ENXIO;
+			break;
+		}
+
+		if (msg->flags & I2C_M_RD) {
+			val = tmp117_sim_read_reg(chip, chip->ptr);
+			for (j = 0; j < msg->len; j++)
+				msg->buf[j] = (j & 1) ? val & 0xff : val >> 8;
+		} else {
+			if (msg->len >= 1)
+				chip->ptr = msg->buf[0];
+			if (msg->len >= 3)
+				tmp117_sim_write_reg(chip, chip->ptr,
+						     get_unaligned_be16(&msg->buf[1]));
+		}
+
+		fire |= tmp117_sim_update_alert(chip);
+	}
+
+	spin_unlock_irqrestore(&sim->lock, irqflags);
+
+	if (fire)
+		generic_handle_irq_safe(sim->irq);
+
+	if (READ_ONCE(latency_us))
+		fsleep(READ_ONCE(latency_us));
+
+	return ret;
+}
+
+static u32 tmp117_sim_functionality(struct i2c_adapter *adap)
+{
+	return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm tmp117_sim_algo = {
+	.master_xfer = tmp117_sim_xfer,
+	.functionality = tmp117_sim_functionality,
+};
+
+// ALERT is a plain software interrupt: nothing to mask or acknowledge
+static int tmp117_sim_irq_map(struct irq_domain *d, unsigned int virq,
+			      irq_hw_number_t hw)
+{
+	irq_set_chip_and_handler(virq, &dummy_irq_chip, handle_simple_irq);
+	irq_set_chip_data(virq, d->host_data);
+	return 0;
+}
+
+static const struct irq_domain_ops tmp117_sim_irq_ops = {
+	.map = tmp117_sim_irq_map,
+	.xlate = irq_domain_xlate_onecell,
+};
+
+static void tmp117_sim_irq_remove(void *arg)
+{
+	struct tmp117_sim *sim = arg;
+
+	if (sim->irq)
+		irq_dispose_mapping(sim->irq);
+	irq_domain_remove(sim->domain);
+}
+
+// Runs after the adapter (and with it the client) is gone
+static void tmp117_sim_stop(void *arg)
+{
+	struct tmp117_sim *sim = arg;
+	unsigned int i;
+
+	for (i = 0; i < sim->nr; i++)
+		hrtimer_cancel(&sim->chips[i].timer);
+}
+
+// Create the client named by the instantiate parameter, with its
+// firmware properties as a software node
+static int tmp117_sim_new_client(struct tmp117_sim *sim)
+{
+	struct i2c_board_info info = {
+		.addr = SIM_BASE_ADDR,
+		.swnode = &sim->swnode,
+	};
+	struct property_entry *prop = sim->props;
+	struct i2c_client *client;
+	unsigned int i;
+
+	if (!strcmp(instantiate, "bbb_tmp117")) {
+		strscpy(info.type, "bbb_tmp117", sizeof(info.type));
+		if (!no_irq)
+			info.irq = sim->irq;
+		if (alert_limits)
+			*prop++ = PROPERTY_ENTRY_BOOL("bbb,alert-limits");
+		if (one_shot)
+			*prop++ = PROPERTY_ENTRY_BOOL("bbb,one-shot");
+	} else if (!strcmp(instantiate, "bbb_tmp117_array")) {
+		strscpy(info.type, "bbb_tmp117_array", sizeof(info.type));
+		for (i = 0; i < sim->nr; i++)
+			sim->addrs[i] = sim->chips[i].addr;
+		*prop++ = PROPERTY_ENTRY_U32_ARRAY_LEN("bbb,sensor-addresses",
+						       sim->addrs, sim->nr);
+	} else {
+		return 0;
+	}
+
+	sim->swnode.properties = sim->props;
+
+	// Unregistered together with the adapter
+	client = i2c_new_client_device(&sim->adap, &info);
+	return PTR_ERR_OR_ZERO(client);
+}
+
+static int tmp117_sim_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct tmp117_sim *sim;
+	unsigned long irqflags;
+	unsigned int i;
+	int ret;
+
+	sim = devm_kzalloc(dev, sizeof(*sim), GFP_KERNEL);
+	if (!sim)
+		return -ENOMEM;
+
+	spin_lock_init(&sim->lock);
+	sim->t0 = ktime_get();
+	sim->nr = clamp(nr_sensors, 1U, (unsigned int)SIM_MAX_SENSORS);
+
+	for (i = 0; i < sim->nr; i++) {
+		struct tmp117_sim_chip *chip = &sim->chips[i];
+
+		chip->sim = sim;
+		chip->index = i;
+		chip->addr = SIM_BASE_ADDR + i;
+		chip->config = SIM_CONFIG_DEFAULT;
+		chip->thigh = (s16)SIM_THIGH_DEFAULT;
+		chip->tlow = (s16)SIM_TLOW_DEFAULT;
+		hrtimer_init(&chip->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		chip->timer.function = tmp117_sim_convert;
+	}
+
+	sim->domain = irq_domain_add_linear(NULL, 1, &tmp117_sim_irq_ops, sim);
+	if (!sim->domain)
+		return -ENOMEM;
+
+	ret = devm_add_action_or_reset(dev, tmp117_sim_irq_remove, sim);
+	if (ret)
+		return ret;
+
+	sim->irq = irq_create_mapping(sim->domain, 0);
+	if (!sim->irq)
+		return -ENOMEM;
+
+	ret = devm_add_action_or_reset(dev, tmp117_sim_stop, sim);
+	if (ret)
+		return ret;
+
+	// Power-on: continuous conversion
+	spin_lock_irqsave(&sim->lock, irqflags);
+	for (i = 0; i < sim->nr; i++)
+		tmp117_sim_arm(&sim->chips[i]);
+	spin_unlock_irqrestore(&sim->lock, irqflags);
+
+	sim->adap.owner = THIS_MODULE;
+	sim->adap.algo = &tmp117_sim_algo;
+	sim->adap.dev.parent = dev;
+	strscpy(sim->adap.name, SIM_NAME, sizeof(sim->adap.name));
+	i2c_set_adapdata(&sim->adap, sim);
+
+	ret = devm_i2c_add_adapter(dev, &sim->adap);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to add I2C adapter\n");
+
+	ret = tmp117_sim_new_client(sim);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to create %s\n",
+				     instantiate);
+
+	dev_info(dev, "simulated TMP117 x%u on %s (profile=%s, ALERT irq %u)\n",
+		 sim->nr, dev_name(&sim->adap.dev),
+		 tmp117_sim_profiles[profile], sim->irq);
+	return 0;
+}
+
+static struct platform_driver tmp117_sim_driver = {
+	.probe = tmp117_sim_probe,
+	.driver = {
+		.name = SIM_NAME,
+	},
+};
+
+static struct platform_device *tmp117_sim_pdev;
+
+static int __init tmp117_sim_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&tmp117_sim_driver);
+	if (ret)
+		return ret;
+
+	tmp117_sim_pdev = platform_device_register_simple(SIM_NAME, -1, NULL, 0);
+	if (IS_ERR(tmp117_sim_pdev)) {
+		platform_driver_unregister(&tmp117_sim_driver);
+		return PTR_ERR(tmp117_sim_pdev);
+	}
+
+	return 0;
+}
+module_init(tmp117_sim_init);
+
+static void __exit tmp117_sim_exit(void)
+{
+	platform_device_unregister(tmp117_sim_pdev);
+	platform_driver_unregister(&tmp117_sim_driver);
+}
+module_exit(tmp117_sim_exit);
+
+MODULE_AUTHOR("Chun");
+MODULE_DESCRIPTION("Simulated TMP117 sensors behind a stub I2C adapter");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,188 @@
+#!/bin/bash
+#
+# TMP117 Read-Path Benchmark Suite
+#
+# Drives N concurrent readers of temp1_input (plus the IIO buffer where a
+# data-ready trigger exists) through tmp117-bench and reports per-read
+# latency percentiles, I2C transactions per second and CPU time: the
+# bench process's own, the driver's IRQ thread, and all kernel time as an
+# upper bound for the rest (the sampler runs in a shared kworker).
+#
+# With --sim, every driver access mode is measured in turn against the
+# simulated sensor (bbb_tmp117_sim), whose xfers counter gives the exact
+# I2C traffic. Without it, the already-bound sensor is measured as is and
+# traffic is counted with the i2c:i2c_write tracepoint, filtered to the
+# sensor's adapter and address so PMIC or EEPROM traffic is left out.
+#
+# Usage:
+#   ./bench-tmp117.sh [--sim] [readers] [rate-hz] [seconds] [interval-ms]
+#
+#   rate-hz 0 reads flat out. Must run as root; --sim expects the modules
+#   in ../drivers/tmp117 (override with MOD_DIR=...).
+#
+
+SIM=0
+if [ "$1" = "--sim" ]; then
+    SIM=1
+    shift
+fi
+
+READERS="${1:-4}"
+RATE="${2:-0}"
+SECONDS_RUN="${3:-5}"
+INTERVAL_MS="${4:-16}"
+SCRIPT_DIR="$(dirname "$0")"
+MOD_DIR="${MOD_DIR:-$SCRIPT_DIR/../drivers/tmp117}"
+BENCH="${BENCH:-/tmp/tmp117-bench}"
+SIM_PARAMS="/sys/module/bbb_tmp117_sim/parameters"
+CLK_TCK=$(getconf CLK_TCK)
+TRACE="/sys/kernel/tracing"
+[ -d "$TRACE/events" ] || TRACE="/sys/kernel/debug/tracing"
+
+echo "==================================="
+echo "TMP117 Read-Path Benchmark"
+echo "==================================="
+echo "readers=$READERS rate=${RATE}Hz duration=${SECONDS_RUN}s interval=${INTERVAL_MS}ms"
+echo ""
+
+if ! ${CC:-cc} -O2 -pthread -o "$BENCH" "$SCRIPT_DIR/tmp117-bench.c"; then
+    echo "❌ Cannot build tmp117-bench"
+    exit 1
+fi
+
+# Find the bbb_tmp117 hwmon and IIO directories
+find_devices() {
+    HWMON=""
+    IIO_DEV=""
+    for dev in /sys/class/hwmon/hwmon*; do
+        [ "$(cat "$dev/name" 2>/dev/null)" = "bbb_tmp117" ] && HWMON="$dev"
+    done
+    for dev in /sys/bus/iio/devices/iio:device*; do
+        [ "$(cat "$dev/name" 2>/dev/null)" = "bbb_tmp117" ] && IIO_DEV="$dev"
+    done
+}
+
+# Count only the sensor's transactions: the first message of each is the
+# register pointer (or register) write. Needs HWMON from find_devices.
+trace_filter() {
+    local client
+    client=$(basename "$(readlink -f "$HWMON/device")")    # e.g. 2-0048
+    echo "adapter_nr == ${client%%-*} && addr == 0x${client#*-} && msg_nr == 0" \
+        > "$TRACE/events/i2c/i2c_write/filter"
+}
+
+# I2C transfers so far: simulator counter or tracepoint hits
+xfer_count() {
+    if [ "$SIM" -eq 1 ]; then
+        cat "$SIM_PARAMS/xfers"
+    else
+        grep -c "i2c_write" "$TRACE/trace"
+    fi
+}
+
+xfer_reset() {
+    if [ "$SIM" -eq 1 ]; then
+        echo 0 > "$SIM_PARAMS/xfers"
+    else
+        echo > "$TRACE/trace"
+    fi
+}
+
+# On-CPU time (ns) of the driver's IRQ threads, from schedstat
+irq_thread_ns() {
+    local d comm ns total=0
+    for d in /proc/[0-9]*; do
+        comm=$(cat "$d/comm" 2>/dev/null)
+        case "$comm" in
+        irq/*-bbb_tmp1*)    # comm is cut to 15 characters
+            read -r ns _ < "$d/schedstat" 2>/dev/null && total=$((total + ns))
+            ;;
+        esac
+    done
+    echo "$total"
+}
+
+# Kernel time on all CPUs (system + irq + softirq), in clock ticks
+kernel_ticks() {
+    awk '/^cpu / { print $4 + $7 + $8 }' /proc/stat
+}
+
+# Enable the IIO buffer on the driver's own data-ready trigger, if any.
+# Sets STREAM_ARGS for tmp117-bench.
+start_stream() {
+    STREAM_ARGS=""
+    local trig
+    trig=$(cat "$IIO_DEV/trigger/current_trigger" 2>/dev/null)
+    [ -n "$trig" ] || return
+
+    echo 1 > "$IIO_DEV/scan_elements/in_temp_en"
+    echo 1 > "$IIO_DEV/scan_elements/in_timestamp_en"
+    echo 1 > "$IIO_DEV/buffer/enable"
+    # s16 sample, padding, s64 timestamp
+    STREAM_ARGS="-s /dev/$(basename "$IIO_DEV") -b 16"
+}
+
+stop_stream() {
+    [ -n "$STREAM_ARGS" ] && echo 0 > "$IIO_DEV/buffer/enable"
+}
+
+# Run one measurement: run_mode <label>
+run_mode() {
+    echo "--- $1 ---"
+    find_devices
+    if [ -z "$HWMON" ]; then
+        echo "❌ bbb_tmp117 hwmon device NOT found"
+        echo "   → Check dmesg for probe errors"
+        return 1
+    fi
+
+    echo "$INTERVAL_MS" > "$HWMON/update_interval" 2>/dev/null
+    [ "$SIM" -eq 1 ] || trace_filter
+    start_stream
+
+    local n irq0 irq1 k0 k1
+    xfer_reset
+    irq0=$(irq_thread_ns)
+    k0=$(kernel_ticks)
+    "$BENCH" -f "$HWMON/temp1_input" -n "$READERS" -r "$RATE" \
+        -d "$SECONDS_RUN" $STREAM_ARGS | sed 's/^/   /'
+    k1=$(kernel_ticks)
+    irq1=$(irq_thread_ns)
+    n=$(xfer_count)
+
+    stop_stream
+    echo "   i2c:      $n transfers ($((n / SECONDS_RUN))/s)"
+    echo "   kernel:   irq thread $(((irq1 - irq0) / 1000000)) ms," \
+         "all kernel time $(((k1 - k0) * 1000 / CLK_TCK)) ms" \
+         "(upper bound: also sampler kworker and unrelated work)"
+    echo ""
+}
+
+# Reload simulator and driver with the given simulator parameters
+load_sim() {
+    rmmod bbb_tmp117 2>/dev/null
+    rmmod bbb_tmp117_sim 2>/dev/null
+    insmod "$MOD_DIR/bbb_tmp117_sim.ko" "$@" || return 1
+    insmod "$MOD_DIR/bbb_tmp117.ko" || return 1
+    sleep 1  # Let the first conversion land
+}
+
+if [ "$SIM" -eq 1 ]; then
+    load_sim no_irq=1 && run_mode "polled (per-cycle cache)"
+    load_sim && run_mode "data-ready irq + IIO stream"
+    load_sim alert_limits=1 && run_mode "limit alert irq"
+    load_sim one_shot=1 no_irq=1 && run_mode "one-shot, hrtimer wait"
+    load_sim one_shot=1 && run_mode "one-shot, data-ready wait"
+
+    rmmod bbb_tmp117
+    rmmod bbb_tmp117_sim
+else
+    if [ ! -d "$TRACE/events/i2c/i2c_write" ]; then
+        echo "❌ i2c tracepoints unavailable, cannot count transfers"
+        exit 1
+    fi
+    echo 1 > "$TRACE/events/i2c/i2c_write/enable"
+    run_mode "bound sensor"
+    echo 0 > "$TRACE/events/i2c/i2c_write/enable"
+    echo 0 > "$TRACE/events/i2c/i2c_write/filter"
+fi
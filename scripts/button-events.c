@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Button event consumer
+ *
+ * Prints binary records from /dev/bbb-button-bin, either with read() or
+ * straight from the mmap()ed event ring, and reports records missed by
+ * falling behind.
+ *
+ * Build:
+ *   cc -O2 -I../drivers/button -o button-events button-events.c
+ *
+ * Usage:
+ *   button-events [-d device] [-m] [-s]
+ *
+ * Author: Chun
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "bbb_flagship_button_uapi.h"
+
+static void print_rec(const struct bbb_btn_event_rec *rec)
+{
+	printf("seq=%llu time=%llu %s count=%llu%s\n",
+	       (unsigned long long)rec->seq,
+	       (unsigned long long)rec->ts_ns,
+	       rec->state ? "pressed" : "released",
+	       (unsigned long long)rec->press_count,
+	       rec->flags & BBB_BTN_EV_OVERFLOW ? " (missed events)" : "");
+	fflush(stdout);
+}
+
+static int consume_read(int fd)
+{
+	struct bbb_btn_event_rec recs[16];
+	ssize_t n, i;
+
+	for (;;) {
+		n = read(fd, recs, sizeof(recs));
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("read");
+			return 1;
+		}
+		for (i = 0; i < n / (ssize_t)sizeof(recs[0]); i++)
+			print_rec(&recs[i]);
+	}
+}
+
+/* Follows the protocol documented in bbb_flagship_button_uapi.h */
+static int consume_mmap(int fd, int spin)
+{
+	const struct bbb_btn_ring_header *hdr;
+	const struct bbb_btn_event_rec *ring;
+	struct bbb_btn_event_rec rec;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint32_t size, tail, head, claim;
+	size_t bytes;
+	void *map;
+
+	/* Map the header first to learn the full size */
+	map = mmap(NULL, getpagesize(), PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	hdr = map;
+	if (hdr->version != BBB_BTN_RING_VERSION ||
+	    hdr->record_size != sizeof(rec)) {
+		fprintf(stderr, "unsupported ring version %u\n", hdr->version);
+		return 1;
+	}
+	size = hdr->ring_size;
+	bytes = hdr->ring_bytes;
+
+	/* The driver's mapping cannot grow, so map it again in full */
+	munmap(map, getpagesize());
+	map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	hdr = map;
+	ring = (const void *)((const char *)map + hdr->data_offset);
+
+	tail = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	for (;;) {
+		head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+		if (tail == head) {
+			/* Caught up: hand our tail to the driver and sleep */
+			if (!spin && !ioctl(fd, BBB_BTN_IOC_SET_TAIL, &tail))
+				poll(&pfd, 1, -1);
+			continue;
+		}
+
+		claim = __atomic_load_n(&hdr->claim, __ATOMIC_RELAXED);
+		if (claim - tail > size) {
+			fprintf(stderr, "missed %u events\n", claim - size - tail);
+			tail = claim - size;
+		}
+
+		rec = ring[tail & (size - 1)];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&hdr->claim, __ATOMIC_RELAXED) - tail > size)
+			continue;	/* Overwritten while copying */
+
+		tail++;
+		print_rec(&rec);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-d device] [-m] [-s]\n"
+		"  -d  device node (default /dev/bbb-button-bin)\n"
+		"  -m  read events from the mmap()ed ring instead of read()\n"
+		"  -s  with -m, spin instead of sleeping between checks\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = "/dev/bbb-button-bin";
+	int use_mmap = 0, spin = 0;
+	__u32 format = BBB_BTN_FORMAT_BINARY;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "d:msh")) != -1) {
+		switch (opt) {
+		case 'd': dev = optarg; break;
+		case 'm': use_mmap = 1; break;
+		case 's': spin = 1; break;
+		default: usage(argv[0]); return opt != 'h';
+		}
+	}
+
+	fd = open(dev, O_RDONLY);
+	if (fd < 0) {
+		perror(dev);
+		return 1;
+	}
+
+	/* Either minor works once switched to binary */
+	if (ioctl(fd, BBB_BTN_IOC_SET_FORMAT, &format)) {
+		perror("BBB_BTN_IOC_SET_FORMAT");
+		return 1;
+	}
+
+	return use_mmap ? consume_mmap(fd, spin) : consume_read(fd);
+}
@@ -0,0 +1,160 @@
+#!/bin/bash
+#
+# MCP3008 Driver Regression Tests and Micro-benchmarks
+#
+# Runs against the simulated chip (bbb_mcp3008_sim), so no BeagleBone or
+# wiring is needed. Checks command encoding, 10-bit result decoding and
+# scale reporting, then measures per-conversion and per-scan overhead.
+#
+# Usage:
+#   ./test-mcp3008-sim.sh [module-dir] [iterations]
+#
+# Must run as root with debugfs mounted at /sys/kernel/debug.
+#
+
+MOD_DIR="${1:-$(dirname "$0")/../drivers/mcp3008}"
+ITERATIONS="${2:-2000}"
+SIM_PARAMS="/sys/module/bbb_mcp3008_sim/parameters"
+TRIG_DIR="/sys/kernel/config/iio/triggers/hrtimer/mcp3008bench"
+SCAN_SECONDS=5
+SCAN_HZ=1000
+FAILED=0
+
+pass() {
+    echo "✅ $1"
+}
+
+fail() {
+    echo "❌ $1"
+    FAILED=1
+}
+
+# Set the simulator's per-channel levels: set_levels <c0> ... <c7>
+set_levels() {
+    local IFS=,
+    echo "$*" > "$SIM_PARAMS/level"
+}
+
+echo "==================================="
+echo "MCP3008 Simulated Driver Test"
+echo "==================================="
+echo ""
+
+# Phase 1: Load simulator and driver
+echo "[1/6] Loading modules..."
+rmmod bbb_mcp3008 2>/dev/null
+rmmod bbb_mcp3008_sim 2>/dev/null
+if ! insmod "$MOD_DIR/bbb_mcp3008_sim.ko" waveform=constant latency_us=0; then
+    echo "❌ Cannot load bbb_mcp3008_sim.ko from $MOD_DIR"
+    exit 1
+fi
+if ! insmod "$MOD_DIR/bbb_mcp3008.ko"; then
+    echo "❌ Cannot load bbb_mcp3008.ko from $MOD_DIR"
+    exit 1
+fi
+
+IIO_DEV=""
+for dev in /sys/bus/iio/devices/iio:device*; do
+    if readlink -f "$dev" | grep -q bbb_mcp3008_sim; then
+        IIO_DEV="$dev"
+        break
+    fi
+done
+if [ -z "$IIO_DEV" ]; then
+    echo "❌ IIO device on simulated controller NOT found"
+    echo "   → Check dmesg for probe errors"
+    exit 1
+fi
+IIO_NAME=$(basename "$IIO_DEV")
+SPI_DEV=$(basename "$(dirname "$(readlink -f "$IIO_DEV")")")
+STATS="/sys/kernel/debug/mcp3008-$SPI_DEV/stats"
+echo "✅ Driver bound: $IIO_DEV"
+
+# Phase 2: Command encoding - every channel returns its own level
+echo "[2/6] Checking channel select encoding..."
+set_levels 100 201 302 403 504 605 706 807
+for ch in {0..7}; do
+    expected=$((100 + ch * 101))
+    raw=$(cat "$IIO_DEV/in_voltage${ch}_raw")
+    if [ "$raw" = "$expected" ]; then
+        pass "channel $ch: $raw"
+    else
+        fail "channel $ch: got $raw, expected $expected"
+    fi
+done
+
+# Phase 3: Result decoding - codes exercising bits 9/8 and byte edges
+echo "[3/6] Checking 10-bit result decoding..."
+for code in 0 1 255 256 341 511 512 682 767 768 1022 1023; do
+    set_levels "$code" 0 0 0 0 0 0 0
+    raw=$(cat "$IIO_DEV/in_voltage0_raw")
+    if [ "$raw" = "$code" ]; then
+        pass "code $code"
+    else
+        fail "code $code: got $raw"
+    fi
+done
+
+# Phase 4: Scale - no vref regulator, so 3300 mV / 1024
+echo "[4/6] Checking scale..."
+scale=$(cat "$IIO_DEV/in_voltage_scale")
+if [ "$scale" = "3.222656250" ]; then
+    pass "in_voltage_scale = $scale"
+else
+    fail "in_voltage_scale = $scale, expected 3.222656250"
+fi
+
+# Phase 5: Per-conversion overhead through sysfs
+echo "[5/6] Benchmarking single conversions ($ITERATIONS reads)..."
+echo 1 > "$STATS"
+start=$(date +%s%N)
+for ((i = 0; i < ITERATIONS; i++)); do
+    read -r raw < "$IIO_DEV/in_voltage0_raw"
+done
+end=$(date +%s%N)
+echo "   sysfs read: $(( (end - start) / ITERATIONS )) ns/conversion (incl. syscalls)"
+cat "$STATS" | sed 's/^/   /'
+
+# Phase 6: Per-scan overhead through the triggered buffer
+echo "[6/6] Benchmarking buffered scans (${SCAN_HZ} Hz, ${SCAN_SECONDS} s)..."
+if [ ! -d "$(dirname "$TRIG_DIR")" ] && ! modprobe iio-trig-hrtimer 2>/dev/null; then
+    echo "⚠️  hrtimer trigger unavailable, skipping scan benchmark"
+else
+    mkdir -p "$TRIG_DIR"
+    TRIG_NAME=$(basename "$TRIG_DIR")
+    for trig in /sys/bus/iio/devices/trigger*; do
+        [ "$(cat "$trig/name")" = "$TRIG_NAME" ] && \
+            echo "$SCAN_HZ" > "$trig/sampling_frequency"
+    done
+
+    for ch in {0..7}; do
+        echo 1 > "$IIO_DEV/scan_elements/in_voltage${ch}_en"
+    done
+    echo 1 > "$IIO_DEV/scan_elements/in_timestamp_en"
+    echo "$TRIG_NAME" > "$IIO_DEV/trigger/current_trigger"
+    echo 4096 > "$IIO_DEV/buffer/length"
+
+    echo 1 > "$STATS"
+    echo 1 > "$IIO_DEV/buffer/enable"
+    # 8 x u16 samples + s64 timestamp = 24 bytes per scan
+    bytes=$(timeout "$SCAN_SECONDS" cat "/dev/$IIO_NAME" | wc -c)
+    echo 0 > "$IIO_DEV/buffer/enable"
+
+    scans=$((bytes / 24))
+    echo "   scans: $scans ($((scans / SCAN_SECONDS))/s, requested ${SCAN_HZ}/s)"
+    cat "$STATS" | sed 's/^/   /'
+
+    echo "" > "$IIO_DEV/trigger/current_trigger"
+    rmdir "$TRIG_DIR"
+fi
+
+echo ""
+if [ "$FAILED" -eq 0 ]; then
+    echo "✅ SUCCESS! All MCP3008 checks passed"
+else
+    echo "❌ FAILURES detected"
+fi
+
+rmmod bbb_mcp3008
+rmmod bbb_mcp3008_sim
+exit "$FAILED"
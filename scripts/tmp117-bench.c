@@ -0,0 +1,301 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * TMP117 read-path benchmark
+ *
+ * Runs N reader threads against a sysfs attribute (by default the
+ * bbb_tmp117 hwmon temp1_input), each at a fixed rate or flat out, and
+ * optionally one streaming reader on an IIO buffer character device.
+ * Reports per-read latency percentiles, throughput and the CPU time
+ * spent by this process.
+ *
+ * Build:
+ *   cc -O2 -pthread -o tmp117-bench tmp117-bench.c
+ *
+ * Usage:
+ *   tmp117-bench [-f attr] [-n readers] [-r hz] [-d seconds]
+ *                [-s /dev/iio:deviceX -b scan_bytes]
+ *
+ * Author: Chun
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NSEC_PER_SEC	1000000000LL
+
+struct reader {
+	pthread_t thread;
+	const char *path;
+	long rate_hz;		/* 0 = as fast as possible */
+	int64_t end_ns;
+	uint32_t *lat_ns;	/* One entry per read */
+	size_t nr, cap;
+	unsigned long errors;
+};
+
+struct streamer {
+	pthread_t thread;
+	const char *path;
+	size_t scan_bytes;
+	int64_t end_ns;
+	unsigned long scans;
+};
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t t_ns)
+{
+	struct timespec ts = {
+		.tv_sec = t_ns / NSEC_PER_SEC,
+		.tv_nsec = t_ns % NSEC_PER_SEC,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static int record(struct reader *r, uint32_t lat)
+{
+	if (r->nr == r->cap) {
+		size_t cap = r->cap ? 2 * r->cap : 4096;
+		uint32_t *p = realloc(r->lat_ns, cap * sizeof(*p));
+
+		if (!p)
+			return -1;
+		r->lat_ns = p;
+		r->cap = cap;
+	}
+
+	r->lat_ns[r->nr++] = lat;
+	return 0;
+}
+
+/* sysfs regenerates the attribute on every read from offset 0 */
+static void *reader_fn(void *arg)
+{
+	struct reader *r = arg;
+	int64_t period = r->rate_hz ? NSEC_PER_SEC / r->rate_hz : 0;
+	int64_t next = now_ns();
+	char buf[32];
+	int fd;
+
+	fd = open(r->path, O_RDONLY);
+	if (fd < 0) {
+		perror(r->path);
+		return NULL;
+	}
+
+	while (now_ns() < r->end_ns) {
+		int64_t t0 = now_ns();
+
+		if (pread(fd, buf, sizeof(buf), 0) <= 0)
+			r->errors++;
+		else if (record(r, (uint32_t)(now_ns() - t0)))
+			break;
+
+		if (period) {
+			next += period;
+			sleep_until(next);
+		}
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static void *streamer_fn(void *arg)
+{
+	struct streamer *s = arg;
+	char buf[4096];
+	ssize_t n;
+	int fd;
+
+	fd = open(s->path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(s->path);
+		return NULL;
+	}
+
+	while (now_ns() < s->end_ns) {
+		n = read(fd, buf, sizeof(buf));
+		if (n > 0)
+			s->scans += n / s->scan_bytes;
+		else
+			usleep(1000);
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double pct_us(const uint32_t *v, size_t n, double p)
+{
+	size_t i = (size_t)(p / 100.0 * (n - 1) + 0.5);
+
+	return v[i] / 1000.0;
+}
+
+static double tv_ms(struct timeval tv)
+{
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static const char *default_attr(void)
+{
+	static char path[256];
+	glob_t g;
+	size_t i;
+
+	if (glob("/sys/class/hwmon/hwmon*/name", 0, NULL, &g))
+		return NULL;
+
+	for (i = 0; i < g.gl_pathc; i++) {
+		char name[32] = "";
+		FILE *f = fopen(g.gl_pathv[i], "r");
+
+		if (!f)
+			continue;
+		if (fgets(name, sizeof(name), f) && !strcmp(name, "bbb_tmp117\n")) {
+			snprintf(path, sizeof(path), "%.*s/temp1_input",
+				 (int)(strlen(g.gl_pathv[i]) - strlen("/name")),
+				 g.gl_pathv[i]);
+			fclose(f);
+			globfree(&g);
+			return path;
+		}
+		fclose(f);
+	}
+
+	globfree(&g);
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-f attr] [-n readers] [-r hz] [-d seconds]\n"
+		"          [-s /dev/iio:deviceX -b scan_bytes]\n"
+		"  -f  sysfs attribute to read (default: bbb_tmp117 temp1_input)\n"
+		"  -n  concurrent readers (default 1)\n"
+		"  -r  reads per second per reader, 0 = flat out (default 0)\n"
+		"  -d  duration in seconds (default 5)\n"
+		"  -s  also drain this IIO buffer device\n"
+		"  -b  bytes per scan in that buffer (default 16)\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *attr = NULL, *stream = NULL;
+	struct streamer s = { .scan_bytes = 16 };
+	long readers = 1, rate = 0, seconds = 5;
+	unsigned long errors = 0;
+	struct rusage ru;
+	struct reader *r;
+	uint32_t *all;
+	size_t total = 0;
+	int64_t start;
+	long i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:n:r:d:s:b:h")) != -1) {
+		switch (opt) {
+		case 'f': attr = optarg; break;
+		case 'n': readers = atol(optarg); break;
+		case 'r': rate = atol(optarg); break;
+		case 'd': seconds = atol(optarg); break;
+		case 's': stream = optarg; break;
+		case 'b': s.scan_bytes = atol(optarg); break;
+		default: usage(argv[0]); return opt != 'h';
+		}
+	}
+
+	if (!attr)
+		attr = default_attr();
+	if (!attr || readers < 1 || seconds < 1 || !s.scan_bytes) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	r = calloc(readers, sizeof(*r));
+	if (!r)
+		return 1;
+
+	start = now_ns();
+	for (i = 0; i < readers; i++) {
+		r[i].path = attr;
+		r[i].rate_hz = rate;
+		r[i].end_ns = start + seconds * NSEC_PER_SEC;
+		pthread_create(&r[i].thread, NULL, reader_fn, &r[i]);
+	}
+	if (stream) {
+		s.path = stream;
+		s.end_ns = start + seconds * NSEC_PER_SEC;
+		pthread_create(&s.thread, NULL, streamer_fn, &s);
+	}
+
+	for (i = 0; i < readers; i++) {
+		pthread_join(r[i].thread, NULL);
+		total += r[i].nr;
+		errors += r[i].errors;
+	}
+	if (stream)
+		pthread_join(s.thread, NULL);
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	printf("attr:     %s\n", attr);
+	printf("readers:  %ld @ %s\n", readers, rate ? "fixed rate" : "flat out");
+	if (rate)
+		printf("rate:     %ld Hz per reader\n", rate);
+	printf("reads:    %zu (%.1f/s), errors %lu\n", total,
+	       (double)total / seconds, errors);
+
+	all = malloc((total ? total : 1) * sizeof(*all));
+	if (!all)
+		return 1;
+	for (total = 0, i = 0; i < readers; i++) {
+		memcpy(all + total, r[i].lat_ns, r[i].nr * sizeof(*all));
+		total += r[i].nr;
+	}
+
+	if (total) {
+		qsort(all, total, sizeof(*all), cmp_u32);
+		printf("latency:  p50 %.1f us, p90 %.1f us, p99 %.1f us, "
+		       "p99.9 %.1f us, max %.1f us\n",
+		       pct_us(all, total, 50), pct_us(all, total, 90),
+		       pct_us(all, total, 99), pct_us(all, total, 99.9),
+		       all[total - 1] / 1000.0);
+	}
+
+	if (stream)
+		printf("stream:   %lu scans (%.1f/s)\n", s.scans,
+		       (double)s.scans / seconds);
+
+	printf("cpu:      user %.1f ms, sys %.1f ms (this process)\n",
+	       tv_ms(ru.ru_utime), tv_ms(ru.ru_stime));
+	return 0;
+}